@@ -0,0 +1,198 @@
+/**
+ * SPS30 - Change detection replay benchmark
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Replays a series of measurements, one per second, through
+ * SPS30_change with the settings of Example8 and reports how many
+ * records are emitted per record sampled, and the time per update.
+ *
+ * The series is a capture of Example4 (ten values per line, separated
+ * by tabs) given as the last argument, or else a generated day of
+ * quiet indoor air with sensor noise, a slow drift and two dust events.
+ *********************************************************************
+*/
+
+#include <benchmark/benchmark.h>
+
+#include <vector>
+
+#include "sps30_change.h"
+
+// The settings of Example8.
+#define MASS_DEADBAND 2.0
+#define MASS_RELATIVE 0.1
+#define NUM_DEADBAND 10.0
+#define NUM_RELATIVE 0.1
+#define SIZE_DEADBAND 0.1
+#define MASS_RATE 5.0
+#define HEARTBEAT_MS 60000
+
+#define DAY_SECONDS 86400
+
+static std::vector<Measurements> series;
+static const char *source = "generated day";
+
+// load_capture reads the lines with ten values of an Example4 capture, other lines are skipped.
+static boolean load_capture(const char *path)
+{
+    FILE *file = fopen(path, "r");
+    char line[256];
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    while (fgets(line, sizeof(line), file) != NULL)
+    {
+        Measurements v;
+        float *values = &v.MassPM1;
+        char *p = line;
+        int count = 0;
+
+        for (; count < 10; count++)
+        {
+            char *end;
+            values[count] = strtof(p, &end);
+            if (end == p)
+            {
+                break;
+            }
+            p = end;
+        }
+
+        if (count == 10)
+        {
+            series.push_back(v);
+        }
+    }
+
+    fclose(file);
+    source = path;
+
+    return !series.empty();
+}
+
+// noise returns a deterministic value between -1 and 1.
+static float noise()
+{
+    static uint32_t state = 12345;
+
+    state = state * 1103515245 + 12345;
+    return (float)(state >> 8 & 0xFFFF) / 32768 - 1;
+}
+
+// generate_day fills the series with a day of PM2.5 around 4 to 8 μg/m3, with 5% noise and two dust events.
+static void generate_day()
+{
+    for (uint32_t t = 0; t < DAY_SECONDS; t++)
+    {
+        float mass = 6 + 2 * sin(2 * M_PI * t / DAY_SECONDS);
+
+        // Cooking at 7:00 and 18:00: up to +80 μg/m3 in 2 minutes, gone after about half an hour.
+        const uint32_t events[] = {7 * 3600, 18 * 3600};
+        for (int e = 0; e < 2; e++)
+        {
+            if (t >= events[e] && t < events[e] + 120)
+            {
+                mass += 80.0 * (t - events[e]) / 120;
+            }
+            else if (t >= events[e] + 120)
+            {
+                mass += 80 * exp(-(float)(t - events[e] - 120) / 600);
+            }
+        }
+
+        mass *= 1 + 0.05 * noise();
+
+        Measurements v;
+        v.MassPM1 = 0.9 * mass;
+        v.MassPM2 = mass;
+        v.MassPM4 = 1.05 * mass;
+        v.MassPM10 = 1.1 * mass;
+        v.NumPM0 = 6.5 * mass;
+        v.NumPM1 = 7.5 * mass;
+        v.NumPM2 = 7.6 * mass;
+        v.NumPM4 = 7.6 * mass;
+        v.NumPM10 = 7.6 * mass;
+        v.PartSize = 0.5 + 0.02 * noise();
+        series.push_back(v);
+    }
+}
+
+static void BM_replay(benchmark::State &state)
+{
+    uint32_t reports = 0;
+    uint32_t counts[4] = {0, 0, 0, 0};
+
+    for (auto _ : state)
+    {
+        SPS30_change change;
+
+        for (uint8_t value = MassPM1; value <= MassPM10; value++)
+        {
+            change.set_deadband(value, MASS_DEADBAND, MASS_RELATIVE);
+        }
+        for (uint8_t value = NumPM0; value <= NumPM10; value++)
+        {
+            change.set_deadband(value, NUM_DEADBAND, NUM_RELATIVE);
+        }
+        change.set_deadband(PartSize, SIZE_DEADBAND);
+        change.set_rate(MassPM2, MASS_RATE);
+        change.set_heartbeat(HEARTBEAT_MS);
+
+        memset(counts, 0, sizeof(counts));
+
+        for (size_t i = 0; i < series.size(); i++)
+        {
+            uint8_t fired = change.update(&series[i], i * 1000);
+
+            for (int r = 0; r < 4; r++)
+            {
+                counts[r] += fired >> r & 1;
+            }
+        }
+
+        reports = change.get_report_count();
+    }
+
+    state.SetItemsProcessed(state.iterations() * series.size());
+    state.SetLabel(source);
+    state.counters["sampled"] = series.size();
+    state.counters["emitted"] = reports;
+    state.counters["emitted/sampled"] = (double)reports / series.size();
+    state.counters["deadband"] = counts[1];
+    state.counters["rate"] = counts[2];
+    state.counters["heartbeat"] = counts[3];
+}
+BENCHMARK(BM_replay)->Unit(benchmark::kMillisecond);
+
+int main(int argc, char **argv)
+{
+    benchmark::Initialize(&argc, argv);
+
+    if (argc > 1)
+    {
+        if (!load_capture(argv[argc - 1]))
+        {
+            fprintf(stderr, "No measurements in %s\n", argv[argc - 1]);
+            return 1;
+        }
+    }
+    else
+    {
+        generate_day();
+    }
+
+    benchmark::RunSpecifiedBenchmarks();
+
+    return 0;
+}
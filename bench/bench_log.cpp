@@ -0,0 +1,106 @@
+/**
+ * SPS30 - Sample log benchmarks
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Append and recovery speed of SPS30_log on the Linux file backend,
+ * in a temporary file. The recovery is begin() on a full log: it reads
+ * the segment headers and scans the newest segment only, so its time
+ * grows with the segment size and not with the size of the log.
+ *********************************************************************
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "sps30_log.h"
+
+#define SEGMENTS LOG_MAX_SEGMENTS
+
+static uint32_t segment_size(uint32_t records)
+{
+    return sizeof(LogSegmentHeader) + records * sizeof(LogRecord);
+}
+
+static Measurements measurement(uint32_t n)
+{
+    Measurements v;
+    float *values = &v.MassPM1;
+
+    for (int c = 0; c < 10; c++)
+    {
+        values[c] = n + c;
+    }
+
+    return v;
+}
+
+// Appending records that fill the segments round robin, the erase of a reused segment included.
+static void BM_append(benchmark::State &state)
+{
+    FILE *file = tmpfile();
+    SPS30_file_device device(file, segment_size(state.range(0)), SEGMENTS);
+    SPS30_log log;
+    uint32_t n = 0;
+
+    log.begin(&device);
+    log.clear();
+
+    for (auto _ : state)
+    {
+        Measurements v = measurement(n);
+
+        if (!log.append(&v, n++))
+        {
+            state.SkipWithError("append failed");
+            break;
+        }
+    }
+
+    state.SetItemsProcessed(state.iterations());
+    state.SetBytesProcessed(state.iterations() * sizeof(LogRecord));
+    fclose(file);
+}
+BENCHMARK(BM_append)->Arg(64)->Arg(256)->Arg(1024);
+
+// begin on a log that went round, with the newest segment half full.
+static void BM_recovery(benchmark::State &state)
+{
+    FILE *file = tmpfile();
+    uint32_t records = state.range(0);
+    SPS30_file_device device(file, segment_size(records), SEGMENTS);
+    SPS30_log log;
+
+    log.begin(&device);
+    log.clear();
+
+    for (uint32_t n = 0; n < (SEGMENTS + 1) * records + records / 2; n++)
+    {
+        Measurements v = measurement(n);
+        log.append(&v, n);
+    }
+    fflush(file);
+
+    for (auto _ : state)
+    {
+        SPS30_log recovered;
+
+        if (!recovered.begin(&device) || recovered.end() != log.end())
+        {
+            state.SkipWithError("recovery failed");
+            break;
+        }
+    }
+
+    state.counters["log_records"] = SEGMENTS * records;
+    fclose(file);
+}
+BENCHMARK(BM_recovery)->Arg(64)->Arg(256)->Arg(1024)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
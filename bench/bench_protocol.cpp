@@ -0,0 +1,307 @@
+/**
+ * SPS30 - Protocol benchmarks
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Google Benchmark suite of the encode and decode hot paths, on the
+ * host against the stubs of the tests. Every benchmark reports ns per
+ * call and the bytes per second it handles, as a baseline to hold
+ * changes of these paths against.
+ *
+ * The building blocks, like the CRC's and the byte stuffing, are
+ * private members of SPS30. This file alone opens them up, after the
+ * Arduino stubs and the standard headers are in.
+ *********************************************************************
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "Arduino.h"
+#include "Wire.h"
+#include "sim_sps30.h"
+
+#define private public
+#include "sps30.h"
+#undef private
+
+// A recorded response to read measured value, the values contain bytes that are stuffed.
+static const uint8_t measured_value_frame[] = {
+    0x7E, 0x00, 0x03, 0x00, 0x28, 0x40, 0x20, 0x00, 0x00, 0x40, 0x98, 0x00,
+    0x00, 0x40, 0xFE, 0x00, 0x00, 0x41, 0x7D, 0x31, 0x00, 0x00, 0x41, 0x48,
+    0x00, 0x00, 0x41, 0x70, 0x00, 0x00, 0x41, 0x82, 0x00, 0x00, 0x41, 0x84,
+    0x00, 0x00, 0x41, 0x85, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x45, 0x7E};
+
+// ReplayStream hands out the same frame again after every rewind, what is written is thrown away.
+class ReplayStream : public Stream
+{
+public:
+    ReplayStream(const uint8_t *frame = NULL, size_t length = 0) : _frame(frame), _length(length) {}
+
+    void rewind() { _index = 0; }
+
+    size_t write(uint8_t value)
+    {
+        benchmark::DoNotOptimize(value);
+        return 1;
+    }
+    using Print::write;
+    int available() { return _length - _index; }
+    int read() { return _index < _length ? _frame[_index++] : -1; }
+    int peek() { return _index < _length ? _frame[_index] : -1; }
+
+private:
+    const uint8_t *_frame;
+    size_t _length;
+    size_t _index = 0;
+};
+
+// MeasuredValues answers every I2C read with the 60 bytes of the measured values: 40 data bytes and 20 CRC's.
+class MeasuredValues : public HostWireDevice
+{
+public:
+    MeasuredValues()
+    {
+        for (int i = 0; i < 20; i++)
+        {
+            _answer[i * 3] = 0x40 + i;
+            _answer[i * 3 + 1] = 0x7E - i;
+            _answer[i * 3 + 2] = sim_crc(&_answer[i * 3]);
+        }
+    }
+
+    uint8_t transmission(uint8_t address, const uint8_t *data, size_t length) { return 0; }
+
+    size_t request(uint8_t address, uint8_t *data, size_t length)
+    {
+        size_t size = length < sizeof(_answer) ? length : sizeof(_answer);
+        memcpy(data, _answer, size);
+        return size;
+    }
+
+private:
+    uint8_t _answer[60];
+};
+
+static void BM_SHDLC_create_command(benchmark::State &state)
+{
+    SPS30 sps30;
+    Message message;
+
+    for (auto _ : state)
+    {
+        sps30.SHDLC_create_command(&message, WRITE_AUTO_CLEANING, 0x7E7D1311);
+        benchmark::DoNotOptimize(message);
+    }
+
+    state.SetBytesProcessed(state.iterations() * (message.length + 4));
+}
+BENCHMARK(BM_SHDLC_create_command);
+
+// Every byte value once, 4 of them are stuffed.
+static void BM_byte_stuffing(benchmark::State &state)
+{
+    SPS30 sps30;
+    ReplayStream out;
+
+    sps30._serial = &out;
+
+    for (auto _ : state)
+    {
+        for (int value = 0; value < 256; value++)
+        {
+            sps30.byte_stuffing(value);
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * 256);
+}
+BENCHMARK(BM_byte_stuffing);
+
+static void BM_byte_unstuffing(benchmark::State &state)
+{
+    SPS30 sps30;
+    const uint8_t stuffed[] = {0x31, 0x33, 0x5D, 0x5E};
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 4; i++)
+        {
+            uint8_t value = stuffed[i];
+            benchmark::DoNotOptimize(sps30.byte_unstuffing(&value));
+            benchmark::DoNotOptimize(value);
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * 4);
+}
+BENCHMARK(BM_byte_unstuffing);
+
+// The checksum of a measured value response: header fields and 40 data bytes.
+static void BM_SHDLC_calculate_CRC(benchmark::State &state)
+{
+    SPS30 sps30;
+    Message message;
+
+    memset(&message, 0, sizeof(message));
+    message.command = SHDLC_READ_MEASURED_VALUE;
+    message.length = SHDLC_READ_MEASURED_VALUE_LENGTH;
+    for (int i = 0; i < SHDLC_READ_MEASURED_VALUE_LENGTH; i++)
+    {
+        message.data[i] = i * 37;
+    }
+
+    for (auto _ : state)
+    {
+        benchmark::DoNotOptimize(sps30.SHDLC_calculate_CRC(&message, true));
+    }
+
+    state.SetBytesProcessed(state.iterations() * (message.length + 4));
+}
+BENCHMARK(BM_SHDLC_calculate_CRC);
+
+// The CRC's of a measured value response: 20 words of 2 bytes.
+static void BM_I2C_calculate_CRC(benchmark::State &state)
+{
+    SPS30 sps30;
+    uint8_t data[40];
+
+    for (int i = 0; i < 40; i++)
+    {
+        data[i] = i * 37;
+    }
+
+    for (auto _ : state)
+    {
+        for (int i = 0; i < 40; i += 2)
+        {
+            benchmark::DoNotOptimize(sps30.I2C_calculate_CRC(&data[i]));
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * 40);
+}
+BENCHMARK(BM_I2C_calculate_CRC);
+
+// Parsing a stuffed measured value frame that is already received.
+static void BM_SHDLC_read(benchmark::State &state)
+{
+    SPS30 sps30;
+    ReplayStream replay(measured_value_frame, sizeof(measured_value_frame));
+    Message message;
+
+    sps30._serial = &replay;
+
+    for (auto _ : state)
+    {
+        replay.rewind();
+        if (!sps30.SHDLC_read(&message, TIME_OUT))
+        {
+            state.SkipWithError("SHDLC_read failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * sizeof(measured_value_frame));
+}
+BENCHMARK(BM_SHDLC_read);
+
+// Reading and checking the 60 bytes of the measured values, the stub I2C buffer is 64 bytes.
+static void BM_I2C_read(benchmark::State &state)
+{
+    SPS30 sps30;
+    MeasuredValues device;
+    Message message;
+
+    Wire.attach(&device);
+    sps30._i2c = &Wire;
+
+    for (auto _ : state)
+    {
+        sps30.I2C_create_command(&message, READ_MEASURED_VALUE);
+        if (!sps30.I2C_read(&message, TIME_OUT) || message.length != 40)
+        {
+            state.SkipWithError("I2C_read failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * 60);
+    Wire.attach(NULL);
+}
+BENCHMARK(BM_I2C_read);
+
+// Only the decode of 40 received bytes into the ten floats.
+static void BM_decode_measurements(benchmark::State &state)
+{
+    SPS30 sps30;
+    Measurements v;
+
+    for (auto _ : state)
+    {
+        sps30.decode_measurements(&measured_value_frame[5], 10, &v);
+        benchmark::DoNotOptimize(v);
+    }
+
+    state.SetBytesProcessed(state.iterations() * 40);
+}
+BENCHMARK(BM_decode_measurements);
+
+// A whole read against the simulated sensor, without its latency: command, response, checks and decode.
+static void BM_get_values_UART(benchmark::State &state)
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Serial1);
+    sensor.latency_us = 0;
+    sps30.begin(&Serial1);
+    sps30.start();
+
+    for (auto _ : state)
+    {
+        if (!sps30.get_values(&v))
+        {
+            state.SkipWithError("get_values failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * SHDLC_READ_MEASURED_VALUE_LENGTH);
+    Serial1.attach(NULL);
+}
+BENCHMARK(BM_get_values_UART);
+
+static void BM_get_values_I2C(benchmark::State &state)
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Wire);
+    sensor.latency_us = 0;
+    sps30.begin(&Wire);
+    sps30.start();
+
+    for (auto _ : state)
+    {
+        if (!sps30.get_values(&v))
+        {
+            state.SkipWithError("get_values failed");
+            break;
+        }
+    }
+
+    state.SetBytesProcessed(state.iterations() * I2C_MEASURED_VALUE_LENGTH);
+    Wire.attach(NULL);
+}
+BENCHMARK(BM_get_values_I2C);
+
+BENCHMARK_MAIN();
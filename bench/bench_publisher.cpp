@@ -0,0 +1,92 @@
+/**
+ * SPS30 - Publisher benchmarks
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Fan out of one measurement per sensor to many subscribers, built with
+ * PUBLISHER_MAX_CLIENTS 512, see the Makefile. A publish and flush is
+ * what the sensor loop spends per measurement interval, a tenth of the
+ * clients is too slow and skips it.
+ *********************************************************************
+*/
+
+#include <benchmark/benchmark.h>
+
+#include "sps30_publisher.h"
+
+#define SENSORS 4
+
+// A client that accepts a frame when it has room, like a socket with a send buffer.
+class Client : public Print
+{
+public:
+    int room = 1024;
+    uint32_t bytes = 0;
+
+    size_t write(uint8_t value)
+    {
+        return write(&value, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        benchmark::DoNotOptimize(buffer);
+        bytes += size;
+        return size;
+    }
+
+    int availableForWrite() { return room; }
+};
+
+// publish of every sensor and a flush to the subscribers, that all want every sensor.
+static void BM_fan_out(benchmark::State &state)
+{
+    static Client clients[PUBLISHER_MAX_CLIENTS];
+    SPS30_publisher publisher;
+    uint32_t subscribers = state.range(0);
+    uint32_t time = 0;
+
+    for (uint8_t s = 0; s < SENSORS; s++)
+    {
+        publisher.add_sensor();
+    }
+
+    for (uint32_t i = 0; i < subscribers; i++)
+    {
+        clients[i].room = i % 10 == 9 ? PUBLISHER_FRAME_LENGTH - 1 : 1024; // A tenth has no room for a frame
+        publisher.add_client(&clients[i]);
+    }
+
+    for (auto _ : state)
+    {
+        Measurements v;
+        float *values = &v.MassPM1;
+
+        for (int c = 0; c < 10; c++)
+        {
+            values[c] = time + c;
+        }
+
+        for (uint8_t s = 0; s < SENSORS; s++)
+        {
+            publisher.publish(s, &v, time);
+        }
+
+        publisher.flush();
+        time += MEASUREMENT_INTERVAL_MS;
+    }
+
+    state.SetItemsProcessed(publisher.get_sent_count());
+    state.SetBytesProcessed((int64_t)publisher.get_sent_count() * PUBLISHER_FRAME_LENGTH);
+    state.counters["skipped"] = benchmark::Counter(publisher.get_skipped_count(), benchmark::Counter::kAvgIterations);
+}
+BENCHMARK(BM_fan_out)->Arg(8)->Arg(100)->Arg(500)->Unit(benchmark::kMicrosecond);
+
+BENCHMARK_MAIN();
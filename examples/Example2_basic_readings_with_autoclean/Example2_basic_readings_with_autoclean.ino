@@ -141,11 +141,11 @@ void get_and_set_auto_clean_interval()
   uint32_t interval;
   boolean succeeded;
 
-  succeeded = sps30.get_auto_clean_interval(&interval); // Read the auto cleaning interval
-  if (succeeded == true)
+  SPS30_value<uint32_t> current = sps30.get_auto_clean_interval(); // Read the auto cleaning interval
+  if (current)
   {
     _SERIAL.print(F("Current auto cleaning interval: "));
-    _SERIAL.print(interval);
+    _SERIAL.print(current.value);
     _SERIAL.println(F(" seconds"));
   }
   else
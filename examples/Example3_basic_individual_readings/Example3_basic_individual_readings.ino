@@ -185,43 +185,43 @@ boolean read_sensor_data()
     switch (values[i])
     {
     case MassPM1:
-      _SERIAL.print(sps30.get_mass_PM1());
+      _SERIAL.print(sps30.get_mass_PM1().value);
       _SERIAL.print(F("\t"));
       break;
     case MassPM2:
-      _SERIAL.print(sps30.get_mass_PM2());
+      _SERIAL.print(sps30.get_mass_PM2().value);
       _SERIAL.print(F("\t"));
       break;
     case MassPM4:
-      _SERIAL.print(sps30.get_mass_PM4());
+      _SERIAL.print(sps30.get_mass_PM4().value);
       _SERIAL.print(F("\t"));
       break;
     case MassPM10:
-      _SERIAL.print(sps30.get_mass_PM10());
+      _SERIAL.print(sps30.get_mass_PM10().value);
       _SERIAL.print(F("\t"));
       break;
     case NumPM0:
-      _SERIAL.print(sps30.get_num_PM0());
+      _SERIAL.print(sps30.get_num_PM0().value);
       _SERIAL.print(F("\t"));
       break;
     case NumPM1:
-      _SERIAL.print(sps30.get_num_PM1());
+      _SERIAL.print(sps30.get_num_PM1().value);
       _SERIAL.print(F("\t"));
       break;
     case NumPM2:
-      _SERIAL.print(sps30.get_num_PM2());
+      _SERIAL.print(sps30.get_num_PM2().value);
       _SERIAL.print(F("\t"));
       break;
     case NumPM4:
-      _SERIAL.print(sps30.get_num_PM4());
+      _SERIAL.print(sps30.get_num_PM4().value);
       _SERIAL.print(F("\t"));
       break;
     case NumPM10:
-      _SERIAL.print(sps30.get_num_PM10());
+      _SERIAL.print(sps30.get_num_PM10().value);
       _SERIAL.print(F("\t"));
       break;
     case PartSize:
-      _SERIAL.print(sps30.get_part_size());
+      _SERIAL.print(sps30.get_part_size().value);
       _SERIAL.print(F("\t"));
       break;
     }
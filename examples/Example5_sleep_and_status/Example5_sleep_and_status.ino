@@ -100,6 +100,15 @@ void get_device_info()
 
     succeeded = sps30.get_product_type(buf, 32); // Read the product name
     print_device_info("Product type", buf, succeeded);
+
+    Version version;
+    if (sps30.read_version(&version)) // Sleep needs firmware 2.0, the status register 2.2
+    {
+        _SERIAL.print(F("Firmware : "));
+        _SERIAL.print(version.firmware_major);
+        _SERIAL.print(".");
+        _SERIAL.println(version.firmware_minor);
+    }
 }
 
 // print_device_info prints a string based on the ret value and the provided message
@@ -133,11 +142,15 @@ void get_device_status()
 {
     delay(3000); // Wait for all the statusses to become available.
 
-    boolean error;
+    DeviceHealth health;
 
-    sps30.read_speed_status(&error);
+    if (!sps30.read_device_health(&health)) // One read for all statusses.
+    {
+        _SERIAL.println("Could not read the status register.");
+        return;
+    }
 
-    if (error)
+    if (health.speed)
     {
         _SERIAL.println("Fan speed is too low or to high.");
     }
@@ -146,9 +159,7 @@ void get_device_status()
         _SERIAL.println("Fan speed is ok.");
     }
 
-    sps30.read_fan_status(&error);
-
-    if (error)
+    if (health.fan)
     {
         _SERIAL.println("Fan is switched on, but the measured fan speed is 0 RPM.");
     }
@@ -157,15 +168,13 @@ void get_device_status()
         _SERIAL.println("Fan works as expected.");
     }
 
-    sps30.read_laser_status(&error);
-
-    if (error)
+    if (health.laser)
     {
-        _SERIAL.println("Laser current is ok.");
+        _SERIAL.println("Laser is switched on and current is out of range.");
     }
     else
     {
-        _SERIAL.println("Laser is switched on and current is out of range.");
+        _SERIAL.println("Laser current is ok.");
     }
 }
 
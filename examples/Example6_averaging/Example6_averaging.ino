@@ -0,0 +1,77 @@
+/************************************************************************************
+    =========================  Highlevel description ================================
+
+    This example averages a number of consecutive measurements of the SPS30 and
+    rejects outliers with a Hampel filter, for noisy low concentration environments.
+
+    ================================ Disclaimer ======================================
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    ===================================================================================
+
+    NO support, delivered as is, have fun, good luck !!
+*/
+
+#include "sps30.h"
+#include "sps30_average.h"
+
+// Define the serial port you want to use for debugging information and the serial port you want to use for the SPS30
+#define _SERIAL Serial
+#define _SPS30 Serial1
+
+// Number of measurements per average, the sensor produces one every second
+#define SAMPLES 10
+
+//
+// You don't have to change anything below this
+//
+
+SPS30 sps30;
+SPS30_average average(&sps30);
+
+void setup()
+{
+  _SERIAL.begin(115200);
+
+  while (!_SERIAL) // Wait for the serial monitor to connect to the debug serial.
+    ;
+
+  _SPS30.begin(115200);              // Start the Serial port you want to use at a baudrate of 115200bps.
+  while (sps30.begin(&_SPS30) == false) // Pass the serial port along to the library and check if the SPS30 is available.
+  {
+    _SERIAL.println(F("The SPS30 is not responding/available."));
+    delay(1000);
+  }
+
+  sps30.start();
+  average.set_filter(FILTER_HAMPEL); // Replace samples further than 3 MAD's from the running median.
+}
+
+void loop()
+{
+  Measurements val;
+  float confidence;
+
+  SPS30_status status = average.get_values(&val, SAMPLES, &confidence);
+
+  if (!status)
+  {
+    _SERIAL.print(F("Averaging failed with error "));
+    _SERIAL.println(status.error);
+    return;
+  }
+
+  _SERIAL.print(F("PM1.0 "));
+  _SERIAL.print(val.MassPM1);
+  _SERIAL.print(F("\tPM2.5 "));
+  _SERIAL.print(val.MassPM2);
+  _SERIAL.print(F("\tPM10 "));
+  _SERIAL.print(val.MassPM10);
+  _SERIAL.print(F("\tconfidence "));
+  _SERIAL.println(confidence);
+}
@@ -0,0 +1,299 @@
+/************************************************************************************
+    =========================  Highlevel description ================================
+
+    This example benchmarks the protocol hot paths of the library on the target
+    itself. No sensor is needed: a replay stream answers every command with a
+    recorded SHDLC frame, so the measured time is only spent in the library
+    (frame building, byte stuffing, CRC's, parsing and decoding).
+
+    Use the results as a baseline when changing the encode/decode paths.
+
+    The averaging benchmarks time SPS30_average::add per measurement with each
+    outlier filter, on an AVR that shows what the median and Hampel filters cost.
+
+    The serializer benchmarks compare building a JSON record with a print call per
+    field to SPS30_serializer, they also print the bytes per record.
+
+    ================================ Disclaimer ======================================
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    ===================================================================================
+
+    NO support, delivered as is, have fun, good luck !!
+*/
+
+#include "sps30.h"
+#include "sps30_average.h"
+#include "sps30_serializer.h"
+
+// Define the serial port you want to print the results on
+#define _SERIAL Serial
+
+// Number of calls per benchmark
+#define ITERATIONS 1000
+
+//
+// You don't have to change anything below this
+//
+
+// Recorded responses of the SPS30, the measured values and the serial number contain stuffed bytes.
+const uint8_t measured_value_frame[] = {
+    0x7E, 0x00, 0x03, 0x00, 0x28, 0x40, 0x20, 0x00, 0x00, 0x40, 0x98, 0x00,
+    0x00, 0x40, 0xFE, 0x00, 0x00, 0x41, 0x7D, 0x31, 0x00, 0x00, 0x41, 0x48,
+    0x00, 0x00, 0x41, 0x70, 0x00, 0x00, 0x41, 0x82, 0x00, 0x00, 0x41, 0x84,
+    0x00, 0x00, 0x41, 0x85, 0x00, 0x00, 0x3F, 0x00, 0x00, 0x00, 0x45, 0x7E};
+
+const uint8_t serial_number_frame[] = {
+    0x7E, 0x00, 0xD0, 0x00, 0x7D, 0x31, 0x38, 0x45, 0x35, 0x45, 0x36, 0x42,
+    0x36, 0x46, 0x33, 0x43, 0x32, 0x41, 0x31, 0x44, 0x30, 0x46, 0x00, 0x5F, 0x7E};
+
+const uint8_t start_frame[] = {0x7E, 0x00, 0x00, 0x00, 0x00, 0xFF, 0x7E};
+const uint8_t auto_clean_frame[] = {0x7E, 0x00, 0x80, 0x00, 0x00, 0x7F, 0x7E};
+
+// ReplayStream answers every received SHDLC frame with the recorded response to its command.
+class ReplayStream : public Stream
+{
+public:
+    uint32_t bytes = 0; // Bytes sent and received
+
+    size_t write(uint8_t value)
+    {
+        bytes++;
+
+        if (value == 0x7E)
+        {
+            if (_position > 1) // The trailer of a frame, queue the response.
+            {
+                respond();
+                _position = 0;
+                return 1;
+            }
+            _position = 0;
+        }
+
+        if (_position == 2)
+        {
+            _command = value;
+        }
+
+        _position++;
+        return 1;
+    }
+
+    int available() { return _length - _index; }
+    int read()
+    {
+        if (_index >= _length)
+        {
+            return -1;
+        }
+        bytes++;
+        return _frame[_index++];
+    }
+    int peek() { return _index < _length ? _frame[_index] : -1; }
+    void flush() {}
+
+private:
+    const uint8_t *_frame = NULL;
+    uint8_t _length = 0;
+    uint8_t _index = 0;
+    uint8_t _position = 0;
+    uint8_t _command = 0;
+
+    void respond()
+    {
+        switch (_command)
+        {
+        case SHDLC_READ_MEASURED_VALUE:
+            _frame = measured_value_frame;
+            _length = sizeof(measured_value_frame);
+            break;
+        case SHDLC_READ_DEVICE_INFO:
+            _frame = serial_number_frame;
+            _length = sizeof(serial_number_frame);
+            break;
+        case SHDLC_AUTO_CLEANING_INTERVAL:
+            _frame = auto_clean_frame;
+            _length = sizeof(auto_clean_frame);
+            break;
+        default:
+            _frame = start_frame;
+            _length = sizeof(start_frame);
+            break;
+        }
+        _index = 0;
+    }
+};
+
+// CountingPrint throws away everything that is printed and counts the bytes.
+class CountingPrint : public Print
+{
+public:
+    uint32_t bytes = 0;
+
+    size_t write(uint8_t value)
+    {
+        bytes++;
+        return 1;
+    }
+
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        bytes += size;
+        return size;
+    }
+};
+
+// Function prototypes (sometimes the pre-processor does not create prototypes themself on ESPxx)
+void report(const char *name, uint32_t elapsed, uint32_t bytes, uint16_t failures);
+void report_size(uint32_t bytes);
+void print_json(Print *out, Measurements *v);
+
+ReplayStream replay;
+SPS30 sps30;
+
+void setup()
+{
+    _SERIAL.begin(115200);
+
+    while (!_SERIAL) // Wait for the serial monitor to connect to the debug serial.
+        ;
+
+    sps30.begin(&replay);
+    sps30.start();
+
+    _SERIAL.println(F("Benchmark\t\tus/op\tbytes/s\tfailures"));
+
+    Measurements val;
+    char buf[32];
+    uint16_t failures;
+    uint32_t start;
+
+    // Command frame, SHDLC parsing, CRC check and decoding of all ten values.
+    failures = 0;
+    replay.bytes = 0;
+    start = micros();
+    for (uint16_t i = 0; i < ITERATIONS; i++)
+    {
+        failures += !sps30.get_values(&val);
+    }
+    report("get_values\t", micros() - start, replay.bytes, failures);
+
+    // Unstuffing of a response.
+    failures = 0;
+    replay.bytes = 0;
+    start = micros();
+    for (uint16_t i = 0; i < ITERATIONS; i++)
+    {
+        failures += !sps30.get_serial_number(buf, sizeof(buf));
+    }
+    report("get_serial_number", micros() - start, replay.bytes, failures);
+
+    // Byte stuffing of a parameter.
+    failures = 0;
+    replay.bytes = 0;
+    start = micros();
+    for (uint16_t i = 0; i < ITERATIONS; i++)
+    {
+        failures += !sps30.set_auto_clean_interval(0x7E7D1311);
+    }
+    report("set_auto_clean_interval", micros() - start, replay.bytes, failures);
+
+    // The outlier filters, every channel is sorted twice per sample for the median and the MAD.
+    SPS30_average average;
+    Measurements sample = val;
+    const char *filter_names[] = {"average no filter", "average median", "average Hampel"};
+
+    for (uint8_t f = FILTER_NONE; f <= FILTER_HAMPEL; f++)
+    {
+        average.set_filter(f);
+        start = micros();
+        for (uint16_t i = 0; i < ITERATIONS; i++)
+        {
+            sample.MassPM1 = val.MassPM1 + (i * 7) % 13; // Changing values keep the sort busy.
+            average.add(&sample);
+        }
+        report(filter_names[f], micros() - start, 0, 0);
+    }
+
+    // A JSON record built with a print call per field.
+    CountingPrint counter;
+    start = micros();
+    for (uint16_t i = 0; i < ITERATIONS; i++)
+    {
+        print_json(&counter, &val);
+    }
+    report("print JSON\t", micros() - start, counter.bytes, 0);
+    report_size(counter.bytes);
+
+    // The same record from the serializer, as JSON and as CBOR.
+    uint8_t formats[] = {FORMAT_JSON, FORMAT_CBOR};
+    const char *names[] = {"serializer JSON", "serializer CBOR"};
+
+    for (uint8_t f = 0; f < 2; f++)
+    {
+        SPS30_serializer serializer(&counter, formats[f]);
+        counter.bytes = 0;
+        start = micros();
+        for (uint16_t i = 0; i < ITERATIONS; i++)
+        {
+            serializer.add(&val);
+        }
+        report(names[f], micros() - start, counter.bytes, 0);
+        report_size(counter.bytes);
+    }
+}
+
+void loop()
+{
+}
+
+// print_json prints a record the way it is usually done, field by field.
+void print_json(Print *out, Measurements *v)
+{
+    out->print(F("{\"pm1\":"));
+    out->print(v->MassPM1);
+    out->print(F(",\"pm2\":"));
+    out->print(v->MassPM2);
+    out->print(F(",\"pm4\":"));
+    out->print(v->MassPM4);
+    out->print(F(",\"pm10\":"));
+    out->print(v->MassPM10);
+    out->print(F(",\"n0\":"));
+    out->print(v->NumPM0);
+    out->print(F(",\"n1\":"));
+    out->print(v->NumPM1);
+    out->print(F(",\"n2\":"));
+    out->print(v->NumPM2);
+    out->print(F(",\"n4\":"));
+    out->print(v->NumPM4);
+    out->print(F(",\"n10\":"));
+    out->print(v->NumPM10);
+    out->print(F(",\"size\":"));
+    out->print(v->PartSize);
+    out->print(F("}"));
+}
+
+// report prints the time per call and the throughput of a benchmark.
+void report(const char *name, uint32_t elapsed, uint32_t bytes, uint16_t failures)
+{
+    _SERIAL.print(name);
+    _SERIAL.print(F("\t"));
+    _SERIAL.print((float)elapsed / ITERATIONS);
+    _SERIAL.print(F("\t"));
+    _SERIAL.print(elapsed ? (uint32_t)((float)bytes * 1000000.0 / elapsed) : 0);
+    _SERIAL.print(F("\t"));
+    _SERIAL.println(failures);
+}
+
+// report_size prints the bytes per record of a serializer benchmark.
+void report_size(uint32_t bytes)
+{
+    _SERIAL.print(F("\tbytes/record\t"));
+    _SERIAL.println(bytes / ITERATIONS);
+}
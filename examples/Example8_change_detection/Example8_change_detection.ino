@@ -0,0 +1,112 @@
+/************************************************************************************
+    =========================  Highlevel description ================================
+
+    This example reads the SPS30 every second, but only prints a measurement when it
+    left the deadband around the last printed one, rose or fell quickly, or when
+    nothing was printed for a minute. The ratio of printed to read measurements
+    shows how much uplink traffic the change detection would save.
+
+    ================================ Disclaimer ======================================
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+    ===================================================================================
+
+    NO support, delivered as is, have fun, good luck !!
+*/
+
+#include "sps30.h"
+#include "sps30_change.h"
+
+// Define the serial port you want to use for debugging information and the serial port you want to use for the SPS30
+#define _SERIAL Serial
+#define _SPS30 Serial1
+
+// Report when a mass concentration moves more than 2 μg/m3 or 10%, whichever is larger
+#define MASS_DEADBAND 2.0
+#define MASS_RELATIVE 0.1
+
+// Report when a number concentration moves more than 10 #/cm3 or 10%, whichever is larger
+#define NUM_DEADBAND 10.0
+#define NUM_RELATIVE 0.1
+
+// Report when the typical particle size moves more than 0.1 μm
+#define SIZE_DEADBAND 0.1
+
+// Report right away when PM2.5 changes faster than 5 μg/m3 per second
+#define MASS_RATE 5.0
+
+// Report at least once a minute
+#define HEARTBEAT_MS 60000
+
+//
+// You don't have to change anything below this
+//
+
+SPS30 sps30;
+
+void report(const Measurements *v, uint8_t reasons, void *context);
+
+SPS30_change change(report);
+
+void setup()
+{
+  _SERIAL.begin(115200);
+
+  while (!_SERIAL) // Wait for the serial monitor to connect to the debug serial.
+    ;
+
+  _SPS30.begin(115200);              // Start the Serial port you want to use at a baudrate of 115200bps.
+  while (sps30.begin(&_SPS30) == false) // Pass the serial port along to the library and check if the SPS30 is available.
+  {
+    _SERIAL.println(F("The SPS30 is not responding/available."));
+    delay(1000);
+  }
+
+  // Every channel needs a deadband, a channel without one is reported on every change.
+  for (uint8_t value = MassPM1; value <= MassPM10; value++)
+  {
+    change.set_deadband(value, MASS_DEADBAND, MASS_RELATIVE);
+  }
+  for (uint8_t value = NumPM0; value <= NumPM10; value++)
+  {
+    change.set_deadband(value, NUM_DEADBAND, NUM_RELATIVE);
+  }
+  change.set_deadband(PartSize, SIZE_DEADBAND);
+  change.set_rate(MassPM2, MASS_RATE);
+  change.set_heartbeat(HEARTBEAT_MS);
+
+  sps30.start();
+}
+
+void loop()
+{
+  Measurements val;
+
+  delay(MEASUREMENT_INTERVAL_MS);
+
+  if (sps30.get_values(&val))
+  {
+    change.update(&val);
+  }
+}
+
+void report(const Measurements *v, uint8_t reasons, void *context)
+{
+  _SERIAL.print(F("PM1.0 "));
+  _SERIAL.print(v->MassPM1);
+  _SERIAL.print(F("\tPM2.5 "));
+  _SERIAL.print(v->MassPM2);
+  _SERIAL.print(F("\tPM10 "));
+  _SERIAL.print(v->MassPM10);
+  _SERIAL.print(F("\treason "));
+  _SERIAL.print(reasons, HEX);
+  _SERIAL.print(F("\treported "));
+  _SERIAL.print(change.get_report_count());
+  _SERIAL.print(F(" of "));
+  _SERIAL.println(change.get_sample_count());
+}
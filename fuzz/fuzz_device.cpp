@@ -0,0 +1,195 @@
+/**
+ * SPS30 - Fuzzed sensor
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "fuzz_device.h"
+
+#define SHDLC_HEADER 0x7E
+#define SHDLC_STUFFING 0x7D
+
+void fuzz_fail(const char *reason)
+{
+    fprintf(stderr, "fuzz: %s\n", reason);
+    abort();
+}
+
+boolean FuzzInput::next(const uint8_t **answer, size_t *length)
+{
+    if (exhausted())
+    {
+        return false;
+    }
+
+    size_t wanted = _data[_position++];
+    *answer = _data + _position;
+    *length = wanted < _size - _position ? wanted : _size - _position;
+    _position += *length;
+
+    return true;
+}
+
+// shdlc_valid checks a frame like the datasheet describes it, independent of the library.
+static boolean shdlc_valid(const uint8_t *data, size_t length)
+{
+    uint8_t frame[600];
+    size_t count = 0;
+    size_t i = 1;
+
+    if (length == 0 || data[0] != SHDLC_HEADER)
+    {
+        return false;
+    }
+
+    for (; i < length && data[i] != SHDLC_HEADER; i++)
+    {
+        uint8_t value = data[i];
+
+        if (value == SHDLC_STUFFING)
+        {
+            if (++i == length)
+            {
+                return false;
+            }
+
+            switch (data[i])
+            {
+            case 0x5E: value = 0x7E; break;
+            case 0x5D: value = 0x7D; break;
+            case 0x31: value = 0x11; break;
+            case 0x33: value = 0x13; break;
+            default: return false;
+            }
+        }
+
+        frame[count++] = value;
+    }
+
+    // Address, command, state, length, data and checksum up to the trailer.
+    if (i == length || count < 5 || frame[3] != count - 5)
+    {
+        return false;
+    }
+
+    uint8_t sum = 0;
+
+    for (size_t j = 0; j + 1 < count; j++)
+    {
+        sum += frame[j];
+    }
+
+    return (uint8_t)~sum == frame[count - 1];
+}
+
+void FuzzSerialDevice::received(HardwareSerial *port, uint8_t value)
+{
+    if (value != SHDLC_HEADER)
+    {
+        return;
+    }
+
+    _in_frame = !_in_frame;
+
+    if (_in_frame) // Bytes left over from the previous answer are gone by the next command.
+    {
+        port->clear();
+        return;
+    }
+
+    const uint8_t *answer;
+    size_t length;
+
+    if (_input->next(&answer, &length))
+    {
+        port->respond(answer, length, FUZZ_LATENCY_US);
+        _valid |= shdlc_valid(answer, length);
+    }
+}
+
+void FuzzSerialDevice::check()
+{
+    if (!_valid)
+    {
+        fuzz_fail("succeeded without a SHDLC frame with a correct checksum and length");
+    }
+}
+
+uint8_t FuzzWireDevice::transmission(uint8_t address, const uint8_t *data, size_t length)
+{
+    (void)address;
+    (void)data;
+    (void)length;
+
+    return 0;
+}
+
+// i2c_crc is the CRC-8 of the datasheet: polynomial 0x31, initialization 0xFF.
+static uint8_t i2c_crc(const uint8_t *data)
+{
+    uint8_t crc = 0xFF;
+
+    for (uint8_t i = 0; i < 2; i++)
+    {
+        crc ^= data[i];
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+size_t FuzzWireDevice::request(uint8_t address, uint8_t *data, size_t length)
+{
+    const uint8_t *answer;
+    size_t count;
+
+    (void)address;
+
+    if (!_input->next(&answer, &count))
+    {
+        return 0;
+    }
+
+    if (count > length)
+    {
+        count = length;
+    }
+
+    memcpy(data, answer, count);
+
+    boolean valid = count >= 3;
+
+    for (size_t i = 0; i + 3 <= count; i += 3)
+    {
+        if (i2c_crc(data + i) != data[i + 2])
+        {
+            valid = false;
+        }
+    }
+
+    _valid |= valid;
+    _reads++;
+
+    return count;
+}
+
+void FuzzWireDevice::check()
+{
+    if (_reads > 0 && !_valid)
+    {
+        fuzz_fail("succeeded without an I2C read with correct CRC's");
+    }
+}
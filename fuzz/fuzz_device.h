@@ -0,0 +1,89 @@
+/**
+ * SPS30 - Fuzzed sensor Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A sensor that answers with whatever the fuzzer hands it. The input
+ * is a list of answers, each a length byte followed by that many
+ * bytes: the raw SHDLC bytes of a frame, or the bytes of an I2C read.
+ *
+ * Besides the sanitizers the devices check that the library only
+ * accepts what the sensor can send: a command that succeeds must have
+ * had an answer that is a frame with a correct checksum, or I2C words
+ * with correct CRC's. Only one, as begin() also reads the version and
+ * that read may fail on its own.
+ *********************************************************************
+*/
+
+#ifndef FUZZ_DEVICE_H
+#define FUZZ_DEVICE_H
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define FUZZ_LATENCY_US 1000 // Time before an answer arrives
+
+// The answers of one input.
+class FuzzInput
+{
+public:
+    FuzzInput(const uint8_t *data, size_t size) : _data(data), _size(size) {}
+
+    // next gets the next answer, it returns false when the input is used up.
+    boolean next(const uint8_t **answer, size_t *length);
+    boolean exhausted() { return _position >= _size; }
+
+private:
+    const uint8_t *_data;
+    size_t _size;
+    size_t _position = 0;
+};
+
+// Answers every SHDLC frame the library sends with the next answer.
+class FuzzSerialDevice : public HostSerialDevice
+{
+public:
+    FuzzSerialDevice(FuzzInput *input) : _input(input) {}
+
+    void received(HardwareSerial *port, uint8_t value);
+
+    // begin starts a command, check fails when none of its answers was a correct frame.
+    void begin() { _valid = false; }
+    void check();
+
+private:
+    FuzzInput *_input;
+    boolean _in_frame = false;
+    boolean _valid = false; // An answer of the command was a frame with a correct checksum
+};
+
+// Acknowledges every transmission and fills every read with the next answer, an empty answer NACKs.
+class FuzzWireDevice : public HostWireDevice
+{
+public:
+    FuzzWireDevice(FuzzInput *input) : _input(input) {}
+
+    uint8_t transmission(uint8_t address, const uint8_t *data, size_t length);
+    size_t request(uint8_t address, uint8_t *data, size_t length);
+
+    // begin starts a command, check fails when it read but none of the reads had only correct CRC's.
+    void begin() { _reads = 0; _valid = false; }
+    void check();
+
+private:
+    FuzzInput *_input;
+    uint8_t _reads = 0;     // Reads of the command, a write only command has none
+    boolean _valid = false; // A read of the command had only words with a correct CRC
+};
+
+// fuzz_fail stops the run so the fuzzer keeps the input.
+void fuzz_fail(const char *reason);
+
+#endif
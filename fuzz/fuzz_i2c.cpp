@@ -0,0 +1,62 @@
+/**
+ * SPS30 - I2C fuzz target
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Runs the commands that decode an answer over I2C, every read of the
+ * library is filled with the next answer of the input.
+ *********************************************************************
+*/
+
+#include "fuzz_device.h"
+#include "sps30.h"
+
+// COMMAND runs a command while there are answers left, and checks the answer if it succeeded.
+#define COMMAND(call)                      \
+    do                                     \
+    {                                      \
+        if (!input.exhausted())            \
+        {                                  \
+            device.begin();                \
+            if ((call).ok())               \
+            {                              \
+                device.check();            \
+            }                              \
+        }                                  \
+    } while (0)
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+    FuzzInput input(data, size);
+    FuzzWireDevice device(&input);
+    SPS30 sps30;
+    RetryPolicy once = {1, 0, false}; // Every answer belongs to exactly one read.
+    char text[32];
+    Version version;
+    DeviceHealth health;
+    Measurements values;
+
+    Wire.attach(&device);
+    sps30.set_retry_policy(once);
+
+    COMMAND(sps30.begin(&Wire));
+    COMMAND(sps30.read_version(&version));
+    COMMAND(sps30.get_serial_number(text, sizeof(text)));
+    COMMAND(sps30.get_product_type(text, 8));
+    COMMAND(sps30.get_auto_clean_interval());
+    COMMAND(sps30.read_device_health(&health));
+    COMMAND(sps30.start());
+    COMMAND(sps30.read_data_ready());
+    COMMAND(sps30.get_values(&values));
+
+    Wire.attach(NULL);
+
+    return 0;
+}
@@ -0,0 +1,212 @@
+/**
+ * SPS30 - Fuzz driver without libFuzzer
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * For compilers without -fsanitize=fuzzer: runs every input of the
+ * given files and directories, then the number of random mutations of
+ * them given with -runs=. The same seed gives the same runs. An input
+ * that fails is written to crash-input to be run again.
+ *
+ *   build/fuzz_shdlc_standalone -runs=100000 -seed=1 corpus/shdlc
+ *********************************************************************
+*/
+
+#include <dirent.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include <string>
+#include <vector>
+
+extern "C" int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+typedef std::vector<uint8_t> Input;
+
+extern "C" void __sanitizer_set_death_callback(void (*callback)(void)) __attribute__((weak));
+
+static uint32_t _random = 1;
+static const Input *_running = NULL; // The input being run
+
+// next_random is a xorshift generator, so that a run can be repeated.
+static uint32_t next_random()
+{
+    _random ^= _random << 13;
+    _random ^= _random >> 17;
+    _random ^= _random << 5;
+    return _random;
+}
+
+static bool read_file(const char *path, Input *input)
+{
+    FILE *file = fopen(path, "rb");
+
+    if (file == NULL)
+    {
+        return false;
+    }
+
+    int value;
+
+    while ((value = fgetc(file)) != EOF)
+    {
+        input->push_back((uint8_t)value);
+    }
+
+    fclose(file);
+    return true;
+}
+
+// save_running writes the input that failed, for the sanitizers and for an abort.
+static void save_running()
+{
+    FILE *file = _running == NULL ? NULL : fopen("crash-input", "wb");
+
+    if (file != NULL)
+    {
+        fwrite(_running->data(), 1, _running->size(), file);
+        fclose(file);
+        fprintf(stderr, "input written to crash-input\n");
+    }
+}
+
+static void aborted(int signal)
+{
+    save_running();
+    _exit(128 + signal);
+}
+
+static void run_input(const Input *input)
+{
+    _running = input;
+    LLVMFuzzerTestOneInput(input->data(), input->size());
+    _running = NULL;
+}
+
+// add_path adds a file, or every file of a directory.
+static void add_path(const char *path, std::vector<Input> *corpus)
+{
+    DIR *directory = opendir(path);
+
+    if (directory == NULL)
+    {
+        Input input;
+
+        if (read_file(path, &input))
+        {
+            corpus->push_back(input);
+        }
+        else
+        {
+            fprintf(stderr, "can't read %s\n", path);
+        }
+        return;
+    }
+
+    struct dirent *entry;
+
+    while ((entry = readdir(directory)) != NULL)
+    {
+        if (entry->d_name[0] != '.')
+        {
+            add_path((std::string(path) + "/" + entry->d_name).c_str(), corpus);
+        }
+    }
+
+    closedir(directory);
+}
+
+// mutate changes one to four bytes, lengths included, like a fuzzer would.
+static void mutate(Input *input)
+{
+    uint32_t count = 1 + next_random() % 4;
+
+    while (count-- > 0)
+    {
+        size_t position = input->empty() ? 0 : next_random() % input->size();
+
+        switch (next_random() % 5)
+        {
+        case 0: // Flip a bit.
+            if (!input->empty()) (*input)[position] ^= 1 << (next_random() % 8);
+            break;
+        case 1: // Replace a byte, often with a SHDLC special value.
+            if (!input->empty())
+            {
+                static const uint8_t special[] = {0x7E, 0x7D, 0x11, 0x13, 0x00, 0xFF};
+                (*input)[position] = next_random() % 2 ? special[next_random() % sizeof(special)] : next_random();
+            }
+            break;
+        case 2: // Insert a byte.
+            input->insert(input->begin() + position, (uint8_t)next_random());
+            break;
+        case 3: // Remove a byte.
+            if (!input->empty()) input->erase(input->begin() + position);
+            break;
+        case 4: // Cut the input short.
+            input->resize(position);
+            break;
+        }
+    }
+}
+
+int main(int argc, char **argv)
+{
+    std::vector<Input> corpus;
+    unsigned long runs = 0;
+
+    for (int i = 1; i < argc; i++)
+    {
+        if (strncmp(argv[i], "-runs=", 6) == 0)
+        {
+            runs = strtoul(argv[i] + 6, NULL, 10);
+        }
+        else if (strncmp(argv[i], "-seed=", 6) == 0)
+        {
+            _random = strtoul(argv[i] + 6, NULL, 10) | 1;
+        }
+        else
+        {
+            add_path(argv[i], &corpus);
+        }
+    }
+
+    signal(SIGABRT, aborted);
+    if (__sanitizer_set_death_callback != NULL)
+    {
+        __sanitizer_set_death_callback(save_running);
+    }
+
+    if (corpus.empty())
+    {
+        corpus.push_back(Input());
+    }
+
+    for (size_t i = 0; i < corpus.size(); i++)
+    {
+        run_input(&corpus[i]);
+    }
+
+    for (unsigned long run = 0; run < runs; run++)
+    {
+        Input input = corpus[next_random() % corpus.size()];
+
+        mutate(&input);
+        run_input(&input);
+    }
+
+    printf("%s: %zu inputs, %lu mutations\n", argv[0], corpus.size(), runs);
+
+    return 0;
+}
@@ -29,32 +29,190 @@
 // Constructor and initializes variables.
 SPS30::SPS30(void)
 {
-    memset(_reported, 0x1, sizeof(_reported)); // Fill the _reported array with ones.
+    memset(_reported, 0x1, sizeof(_reported));      // Fill the _reported array with ones.
+    memset(_latency, LATENCY_UNKNOWN, sizeof(_latency)); // No response latencies have been measured yet.
 
-    if (I2C_LENGTH >= 64)
-    {
-        _i2c_max_length = true;
-    }
+#ifdef SPS30_PROFILING
+    clear_profile();
+
+#if defined __ARM_ARCH_7M__ || defined __ARM_ARCH_7EM__
+    *(volatile uint32_t *)0xE000EDFC |= (1UL << 24); // Enable the trace unit (DEMCR.TRCENA).
+    *(volatile uint32_t *)0xE0001000 |= 1UL;         // Start the cycle counter (DWT_CTRL.CYCCNTENA).
+#endif
+#endif
 }
 
+#ifndef SPS30_NO_UART
 // Initialize the communication port, starting of the communication port should happen in main sketch.
-boolean SPS30::begin(Stream *the_uart)
+SPS30_status SPS30::begin(Stream *the_uart)
 {
     _serial = the_uart;
     _i2c_mode = false;
 
     return probe();
 }
+#endif
 
+#ifndef SPS30_NO_I2C
 // Initialize the communication port, starting of the communication port should happen in main sketch.
-boolean SPS30::begin(TwoWire *the_wire)
+SPS30_status SPS30::begin(TwoWire *the_wire)
 {
     _i2c = the_wire;
     _i2c_mode = true;
+    _mux = NULL;
+
+    return probe();
+}
+
+// Initialize a sensor behind a channel of an I2C multiplexer, the multiplexer must have been set up with its bus.
+SPS30_status SPS30::begin(SPS30_mux *mux, uint8_t channel)
+{
+    if (channel > 7)
+    {
+        return error(SPS30_ERROR_PARAMETER);
+    }
+
+    _i2c = mux->get_wire();
+    _i2c_mode = true;
+    _mux = mux;
+    _channel = channel;
 
     return probe();
 }
 
+// The multiplexer with a channel switched on, per bus.
+struct MuxBus
+{
+    TwoWire *wire;
+    SPS30_mux *active;
+};
+
+static MuxBus mux_buses[MUX_MAX_BUSES];
+
+// active_mux returns the multiplexer entry of a bus, it takes a free one for a new bus or returns NULL when all are in use.
+static SPS30_mux **active_mux(TwoWire *wire)
+{
+    MuxBus *free = NULL;
+
+    for (uint8_t i = 0; i < MUX_MAX_BUSES; i++)
+    {
+        if (mux_buses[i].wire == wire)
+        {
+            return &mux_buses[i].active;
+        }
+
+        if (mux_buses[i].wire == NULL && free == NULL)
+        {
+            free = &mux_buses[i];
+        }
+    }
+
+    if (free == NULL)
+    {
+        return NULL;
+    }
+
+    free->wire = wire;
+    free->active = NULL;
+
+    return &free->active;
+}
+
+SPS30_mux::SPS30_mux(TwoWire *the_wire, uint8_t address)
+{
+    _wire = the_wire;
+    _address = address;
+}
+
+SPS30_mux::~SPS30_mux()
+{
+    for (uint8_t i = 0; i < MUX_MAX_BUSES; i++)
+    {
+        if (mux_buses[i].active == this)
+        {
+            mux_buses[i].wire = NULL;
+            mux_buses[i].active = NULL;
+        }
+    }
+}
+
+// select switches the multiplexer to a channel, unless it is already selected.
+// Another multiplexer on the bus that has a channel switched on is switched off first.
+boolean SPS30_mux::select(uint8_t channel)
+{
+    SPS30_mux **active = active_mux(_wire);
+
+    if (active == NULL) // More buses with multiplexers than MUX_MAX_BUSES
+    {
+        return false;
+    }
+
+    if (*active == this && channel == _channel)
+    {
+        return true;
+    }
+
+    if (*active != NULL && *active != this)
+    {
+        if (!(*active)->write(0))
+        {
+            return false; // It stays the active one, the next select tries again.
+        }
+
+        (*active)->_channel = MUX_NO_CHANNEL;
+    }
+
+    *active = this;
+
+    if (!write(1 << channel))
+    {
+        return false;
+    }
+
+    _channel = channel;
+
+    return true;
+}
+
+// write switches on the channels of the mask, on a failure the selected channel is unknown.
+boolean SPS30_mux::write(uint8_t channels)
+{
+    _wire->beginTransmission(_address);
+    _wire->write(channels);
+
+    if (_wire->endTransmission() != 0)
+    {
+        _channel = MUX_NO_CHANNEL; // The multiplexer may be in any state now.
+        return false;
+    }
+
+    _switches++;
+
+    return true;
+}
+
+// order sorts sensors by multiplexer and channel, so reading them in this order switches every channel once.
+// Sensors without a multiplexer come first.
+void SPS30_mux::order(SPS30 **sensors, uint8_t count)
+{
+    for (uint8_t i = 1; i < count; i++) // Insertion sort, it keeps the order within a channel.
+    {
+        SPS30 *sensor = sensors[i];
+        uint8_t j = i;
+
+        while (j > 0 && (sensors[j - 1]->get_mux() > sensor->get_mux() ||
+                         (sensors[j - 1]->get_mux() == sensor->get_mux() &&
+                          sensors[j - 1]->get_mux_channel() > sensor->get_mux_channel())))
+        {
+            sensors[j] = sensors[j - 1];
+            j--;
+        }
+
+        sensors[j] = sensor;
+    }
+}
+#endif
+
 // Enable debugging on a Stream object.
 void SPS30::enable_debugging(Stream *debug)
 {
@@ -67,301 +225,746 @@ void SPS30::disable_debugging()
     _SPS30_debug = false;
 }
 
-// probe probes the SPS30 to see if it is available.
-boolean SPS30::probe()
+// probe probes the SPS30 to see if it is available and detects the capabilities of its firmware.
+SPS30_status SPS30::probe()
 {
-    char buf[32];
-    return get_serial_number(buf, 32);
+    SPS30_status status = send_command(READ_DEVICE_SERIAL_NUMBER); // Only the response matters, not the serial number itself.
+
+    if (status && !_version_known)
+    {
+        Version version;
+        read_version(&version); // On a transient failure the detection is tried again on the first use of a capability.
+    }
+
+    return status;
 }
 
-boolean SPS30::reset()
+SPS30_status SPS30::reset()
 {
-    Message response;
-    if (!send_command(&response, RESET))
+    SPS30_status status = send_command(RESET);
+
+    if (status)
     {
-        return false;
+        _started = false;
     }
 
-    _started = false;
-    return true;
+    return status;
 }
 
-boolean SPS30::start()
+SPS30_status SPS30::start()
 {
-    Message response;
-    if (!send_command(&response, START_MEASUREMENT))
+    SPS30_status status = send_command(START_MEASUREMENT);
+
+    if (status)
     {
-        return false;
+        _started = true;
     }
 
-    _started = true;
-    return true;
+    return status;
 }
 
-boolean SPS30::stop()
+SPS30_status SPS30::stop()
 {
-    Message response;
-    if (!send_command(&response, STOP_MEASUREMENT))
+    SPS30_status status = send_command(STOP_MEASUREMENT);
+
+    if (status)
     {
-        return false;
+        _started = false;
     }
 
-    _started = false;
-    return true;
+    return status;
+}
+
+SPS30_status SPS30::clean()
+{
+    return send_command(START_FAN_CLEANING);
 }
 
-boolean SPS30::clean()
+// sleep puts the sensor to sleep, a running measurement is stopped first because sleep is only accepted when idle.
+// Firmware before 2.0 can't sleep, the measurement is stopped instead and SPS30_ERROR_UNSUPPORTED is returned.
+SPS30_status SPS30::sleep()
 {
-    Message response;
-    if (!send_command(&response, START_FAN_CLEANING))
+    if (_started || !supports(CAPABILITY_SLEEP))
     {
-        return false;
+        SPS30_status status = stop();
+
+        if (!status)
+        {
+            return status;
+        }
     }
 
-    return true;
+    if (!supports(CAPABILITY_SLEEP))
+    {
+        return error(SPS30_ERROR_UNSUPPORTED);
+    }
+
+    return send_command(SLEEP);
 }
 
-boolean SPS30::sleep()
+// wake_up wakes the sensor from sleep, on firmware before 2.0 it doesn't do anything and SPS30_ERROR_UNSUPPORTED is returned.
+// While the version is unknown the wake up is sent first: a sleeping sensor doesn't answer anything else, so its version can't be read before.
+SPS30_status SPS30::wake_up()
 {
-    Message response;
-    if (!send_command(&response, SLEEP))
+    if (_version_known && !supports(CAPABILITY_SLEEP)) // Known old firmware, don't wait for the time out.
     {
-        return false;
+        return error(SPS30_ERROR_UNSUPPORTED);
     }
 
-    return true;
+    SPS30_status status = send_command(WAKE_UP);
+
+    if (!status && !supports(CAPABILITY_SLEEP))
+    {
+        return error(SPS30_ERROR_UNSUPPORTED);
+    }
+
+    return status;
 }
 
-boolean SPS30::wake_up()
+// read_version reads the firmware, hardware and SHDLC protocol version and updates the capabilities.
+// Over I2C only the firmware version is available, the other fields are 0.
+SPS30_status SPS30::read_version(Version *response)
 {
-    Message response;
-    if (!send_command(&response, WAKE_UP))
+    SPS30_status status = send_command(READ_VERSION);
+
+    if (!status)
     {
-        return false;
+        // Only an unknown command reply means older than 2.0, a NACK or time out may as well be a sleeping sensor.
+        if (status.error == SPS30_ERROR_STATE_COMMAND)
+        {
+            _capabilities = 0;
+            _version_known = true;
+        }
+
+        return status;
     }
 
-    return true;
+    if (_message.length < (i2c_mode() ? 2 : 7))
+    {
+        return error(SPS30_ERROR_LENGTH);
+    }
+
+    memset(response, 0, sizeof(Version));
+    response->firmware_major = _message.data[0];
+    response->firmware_minor = _message.data[1];
+
+    if (!i2c_mode())
+    {
+        response->hardware = _message.data[3];
+        response->SHDLC_major = _message.data[5];
+        response->SHDLC_minor = _message.data[6];
+    }
+
+    uint16_t firmware = (uint16_t)response->firmware_major << 8 | response->firmware_minor;
+
+    _capabilities = 0;
+    if (firmware >= 0x0200)
+    {
+        _capabilities |= CAPABILITY_SLEEP;
+    }
+    if (firmware >= 0x0202)
+    {
+        _capabilities |= CAPABILITY_STATUS_REGISTER;
+    }
+    _version_known = true;
+
+    return status;
+}
+
+// supports returns whether the firmware has a capability, the version is read when it isn't known yet.
+// If that read fails all capabilities are assumed, so the commands are sent as before, and the version is read again next time.
+boolean SPS30::supports(uint8_t capability)
+{
+    if (!_version_known)
+    {
+        Version version;
+        read_version(&version);
+    }
+
+    return (_capabilities & capability) == capability;
 }
 
-// get_auto_clean_interval reads the interval into a pointer.
-uint32_t SPS30::get_auto_clean_interval()
+// get_auto_clean_interval reads the interval in seconds.
+SPS30_value<uint32_t> SPS30::get_auto_clean_interval()
 {
-    Message response;
+    SPS30_status status = send_command(READ_AUTO_CLEANING);
 
-    if (!send_command(&response, READ_AUTO_CLEANING))
+    if (!status)
     {
-        return 0;
+        return SPS30_value<uint32_t>(status);
     }
 
-    return byte_to_U32(response.data);
+    return SPS30_value<uint32_t>(status, byte_to_U32(_message.data));
 }
 
 // set_auto_clean_interval sets the interval to a value in seconds.
-boolean SPS30::set_auto_clean_interval(uint32_t val)
+SPS30_status SPS30::set_auto_clean_interval(uint32_t val)
 {
-    Message response;
 
-    return send_command(&response, WRITE_AUTO_CLEANING, val);
+    return send_command(WRITE_AUTO_CLEANING, val);
+}
+
+// read_data_ready reports whether new measured values are available.
+// The UART interface has no such command, there new values are expected every measurement interval.
+SPS30_value<boolean> SPS30::read_data_ready()
+{
+    if (!i2c_mode())
+    {
+        return SPS30_value<boolean>(SPS30_status(), millis() - _read_time >= MEASUREMENT_INTERVAL_MS);
+    }
+
+    SPS30_status status = send_command(READ_DATA_READY);
+
+    if (!status)
+    {
+        return SPS30_value<boolean>(status);
+    }
+
+    return SPS30_value<boolean>(status, _message.data[1] == 0x01);
 }
 
 // get_values reads all the sensor values and fills them into a pointer struct.
-boolean SPS30::get_values(Measurements *v)
+SPS30_status SPS30::get_values(Measurements *v)
 {
     // Has a measurement been started?
     if (_started == false)
     {
-        if (start() == false)
+        SPS30_status status = start();
+        if (!status)
         {
-            return false;
+            return status;
         }
     }
 
-    Message response;
+    SPS30_status status = send_command(READ_MEASURED_VALUE);
 
-    if (!send_command(&response, READ_MEASURED_VALUE))
+    if (!status)
     {
-        return false;
+        return status;
     }
 
     // Check the length of the received message.
-    if (response.length != SHDLC_READ_MEASURED_VALUE_LENGTH)
+    if (_message.length != (i2c_mode() ? I2C_MEASURED_VALUE_LENGTH : SHDLC_READ_MEASURED_VALUE_LENGTH))
     {
         if (_SPS30_debug)
         {
-            _debug->print(response.length);
+            _debug->print(_message.length);
             _debug->println(" Bytes received. There aren't enough bytes for all values");
         }
-        return false;
+        return error(SPS30_ERROR_LENGTH);
+    }
+
+    PROFILE_BEGIN();
+
+    // Decode all values in one pass straight into the struct, values that didn't fit the I2C buffer are erased.
+    decode_measurements(_message.data, _message.length / 4, v);
+    memset((uint8_t *)v + _message.length, 0x0, sizeof(Measurements) - _message.length);
+
+    PROFILE_MARK(PROFILE_DECODE);
+
+    _read_time = millis();
+
+    // Piggyback the health snapshot on every n-th measurement, a failure doesn't affect the measured values.
+    if (_health_ratio != 0 && ++_health_count >= _health_ratio)
+    {
+        DeviceHealth health;
+        read_device_health(&health);
+        _health_count = 0;
     }
 
-    memset(v, 0x0, sizeof(Measurements)); // Erase the struct.
+    return status;
+}
 
-    // Extract the data from the array to the struct.
-    v->MassPM1 = byte_to_float(&response.data[0]);
-    v->MassPM2 = byte_to_float(&response.data[4]);
-    v->MassPM4 = byte_to_float(&response.data[8]);
-    v->MassPM10 = byte_to_float(&response.data[12]);
-    if (!_i2c_mode || _i2c_max_length > 20)
+// get_response_latency returns the learned response latency of a command in ms, or LATENCY_UNKNOWN.
+uint8_t SPS30::get_response_latency(uint8_t command)
+{
+    if (command >= NUMBER_OF_COMMANDS)
     {
-        v->NumPM0 = byte_to_float(&response.data[16]);
-        v->NumPM1 = byte_to_float(&response.data[20]);
-        v->NumPM2 = byte_to_float(&response.data[24]);
-        v->NumPM4 = byte_to_float(&response.data[28]);
-        v->NumPM10 = byte_to_float(&response.data[32]);
-        v->PartSize = byte_to_float(&response.data[36]);
+        return LATENCY_UNKNOWN;
     }
+
+    return _latency[command];
+}
+
+#ifdef SPS30_PROFILING
+// clear_profile empties the phase histograms.
+void SPS30::clear_profile()
+{
+    memset(_profile, 0, sizeof(_profile));
+    memset(_profile_ticks, 0, sizeof(_profile_ticks));
 }
+#endif
 
 // Private functions.
 
+#ifdef SPS30_PROFILING
+// profile_mark adds the time since the previous mark to the histogram of a phase.
+void SPS30::profile_mark(uint8_t phase)
+{
+    uint32_t now = SPS30_PROFILE_CLOCK();
+    uint32_t ticks = now - _profile_time;
+    uint8_t bucket = 0;
+
+    _profile_time = now;
+    _profile_ticks[phase] += ticks;
+
+    while ((ticks >>= 1) != 0 && bucket < PROFILE_BUCKETS - 1) // Bucket by the highest set bit.
+    {
+        bucket++;
+    }
+
+    if (_profile[phase][bucket] != 0xFFFF) // Saturate instead of wrapping around.
+    {
+        _profile[phase][bucket]++;
+    }
+}
+#endif
+
 // get_device_info reads the info to a buffer.
-boolean SPS30::get_device_info(uint8_t command, char *ser, uint8_t len)
+SPS30_status SPS30::get_device_info(uint8_t command, char *ser, uint8_t len)
 {
-    Message response;
+    SPS30_status status = send_command(command);
 
-    if (!send_command(&response, command))
+    if (!status)
     {
-        return false;
+        return status;
+    }
+
+    if (len == 0)
+    {
+        return status;
     }
 
-    for (uint8_t i = 0; i < len; i++)
+    // Copy no more than received and always terminate the string.
+    uint8_t length = _message.length < len - 1 ? _message.length : len - 1;
+
+    for (uint8_t i = 0; i < length; i++)
     {
-        ser[i] = response.data[i];
-        if (ser[i] == NULL) // If the byte is empty the serial number is complete.
+        ser[i] = _message.data[i];
+        if (ser[i] == '\0') // If the byte is empty the serial number is complete.
         {
             break;
         }
     }
 
-    return true;
+    ser[length] = '\0';
+
+    return status;
 }
 
 // get_device_status reads out the status register and based on the given command returns one of the statusses to the error boolean. 
-// Based on the clear bit it will read, or read and clear the register.
-boolean SPS30::get_device_status(uint8_t command, boolean *error, boolean clear)
+// Based on the clear bit it will read, or read and clear the register. Use read_device_health to get all statusses in one read.
+SPS30_status SPS30::get_device_status(uint8_t command, boolean *error, boolean clear)
 {
-    Message response;
+    DeviceHealth health;
+    SPS30_status status = read_device_health(&health, clear);
 
-    if (!send_command(&response, READ_STATUS_REGISTER, clear))
+    if (!status)
     {
-        return false;
+        return status;
     }
 
-    uint32_t status_register = byte_to_U32(&response.data[0]);
-
     switch (command)
     {
     case SPEED:
-        *error = (status_register >> 21) & 0x01;
+        *error = health.speed;
         break;
     case FAN:
-        *error = (status_register >> 4) & 0x01;
+        *error = health.fan;
         break;
     case LASER:
-        *error = (status_register >> 5) & 0x01;
+        *error = health.laser;
         break;
     }
 
+    return status;
+}
+
+// read_device_health reads the status register once and decodes all documented bits, optionally clearing the register.
+// SHDLC reads and clears in one command, I2C needs a second command that follows right after the read.
+SPS30_status SPS30::read_device_health(DeviceHealth *health, boolean clear)
+{
+    if (!supports(CAPABILITY_STATUS_REGISTER))
+    {
+        return error(SPS30_ERROR_UNSUPPORTED);
+    }
+
+    SPS30_status status = send_command(READ_STATUS_REGISTER, clear);
+
+    if (!status)
+    {
+        return status;
+    }
+
+    if (_message.length < 4) // SHDLC adds a reserved byte.
+    {
+        return error(SPS30_ERROR_LENGTH);
+    }
+
+    uint32_t status_register = byte_to_U32(&_message.data[0]);
+
+    _health.status_register = status_register;
+    _health.speed = (status_register >> STATUS_SPEED_BIT) & 0x01;
+    _health.laser = (status_register >> STATUS_LASER_BIT) & 0x01;
+    _health.fan = (status_register >> STATUS_FAN_BIT) & 0x01;
+    _health.time = millis();
+    _health_valid = true;
+    _health_count = 0;
+
+    *health = _health;
+
+    if (clear && i2c_mode())
+    {
+        status = send_command(CLEAR_STATUS_REGISTER);
+    }
+
+    return status;
+}
+
+// get_device_health returns the last snapshot without using the bus, false if none has been read yet.
+// With set_health_ratio the snapshot is refreshed along with the measured values.
+boolean SPS30::get_device_health(DeviceHealth *health)
+{
+    if (!_health_valid)
+    {
+        return false;
+    }
+
+    *health = _health;
     return true;
 }
 
-// send_commands sends a command to the SPS30.
-boolean SPS30::send_command(Message *response, uint8_t command, uint32_t parameter)
+// send_commands sends a command to the SPS30, transient errors are retried according to the retry policy.
+SPS30_status SPS30::send_command(uint8_t command, uint32_t parameter)
 {
+    _last_error = SPS30_OK;
+    _last_state = 0;
+
     if ((command == START_FAN_CLEANING) && (_started == false))
     {
         if (_SPS30_debug)
         {
             _debug->println("ERROR : Sensor is not in measurement mode");
         }
+        return error(SPS30_ERROR_NOT_STARTED);
+    }
+
+    uint16_t backoff = _retry_policy.backoff_ms;
+
+    for (uint8_t attempt = 1;; attempt++)
+    {
+#if defined SPS30_NO_I2C
+        boolean succeeded = SHDLC_send_command(&_message, command, parameter);
+#elif defined SPS30_NO_UART
+        boolean succeeded = I2C_send_command(&_message, command, parameter);
+#else
+        boolean succeeded;
+
+        if (_i2c_mode)
+        {
+            succeeded = I2C_send_command(&_message, command, parameter);
+        }
+        else
+        {
+            succeeded = SHDLC_send_command(&_message, command, parameter);
+        }
+#endif
+
+        if (succeeded)
+        {
+            _last_error = SPS30_OK;
+            return SPS30_status(SPS30_OK, _last_state);
+        }
+
+        if (attempt >= _retry_policy.max_attempts || !is_transient(_last_error))
+        {
+            _failures++;
+            return SPS30_status(_last_error, _last_state);
+        }
+
+        if (_SPS30_debug)
+        {
+            _debug->print("Retrying after error ");
+            _debug->println(_last_error);
+        }
+
+        _retries++;
+        delay(backoff);
+        backoff *= 2;
+
+        if (_retry_policy.resync)
+        {
+            resync();
+        }
+    }
+}
+
+// error records an error detected outside of the transport and returns it as a status.
+SPS30_status SPS30::error(SPS30_error error)
+{
+    _last_error = error;
+    return SPS30_status(error, _last_state);
+}
+
+// is_transient returns whether an error can be caused by noise on the bus and is worth retrying.
+boolean SPS30::is_transient(SPS30_error error)
+{
+    switch (error)
+    {
+    case SPS30_ERROR_TIMEOUT:
+    case SPS30_ERROR_HEADER:
+    case SPS30_ERROR_FRAMING:
+    case SPS30_ERROR_CRC:
+    case SPS30_ERROR_LENGTH:
+    case SPS30_ERROR_NACK:
+        return true;
+
+    default:
         return false;
     }
+}
 
-    if (_i2c_mode)
+// decode_state translates the SHDLC state byte into an error.
+SPS30_error SPS30::decode_state(uint8_t state)
+{
+    switch (state & 0x7F) // The MSB only signals a device error flag in the status register.
     {
-        return I2C_send_command(response, command, parameter);
+    case 0x00:
+        return SPS30_OK;
+    case 0x01:
+        return SPS30_ERROR_STATE_LENGTH;
+    case 0x02:
+        return SPS30_ERROR_STATE_COMMAND;
+    case 0x03:
+        return SPS30_ERROR_STATE_ACCESS;
+    case 0x04:
+        return SPS30_ERROR_STATE_PARAMETER;
+    case 0x28:
+        return SPS30_ERROR_STATE_ARGUMENT;
+    case 0x43:
+        return SPS30_ERROR_STATE_NOT_ALLOWED;
+    default:
+        return SPS30_ERROR_STATE_UNKNOWN;
     }
-    else
+}
+
+// resync brings the communication back in a known state before a retry.
+// The UART is drained from any half received frame, the I2C sensor gets a wake pulse.
+void SPS30::resync()
+{
+#ifndef SPS30_NO_I2C
+    if (i2c_mode())
+    {
+        if (_mux != NULL) // A glitch may have reset the multiplexer as well.
+        {
+            _mux->invalidate();
+            _mux->select(_channel);
+        }
+
+        _i2c->beginTransmission(I2C_ADDRESS);
+        _i2c->endTransmission();
+        _ready_time = millis() + RX_DELAY_MS;
+        return;
+    }
+#endif
+
+#ifndef SPS30_NO_UART
+    while (_serial->available())
     {
-        return SHDLC_send_command(response, command, parameter);
+        _serial->read();
     }
+#endif
 }
 
 // get_single_value returns a single value read from the sensor.
 // It acts as a buffer and only if one value is read more than ones it will get new values.
-float SPS30::get_single_value(uint8_t value)
+SPS30_value<float> SPS30::get_single_value(uint8_t value)
 {
-    static Measurements v;
-
-    if (value > PartSize) // If the requested value does not exist return -1.
+    if (value < MassPM1 || value > PartSize) // The requested value does not exist.
     {
-        return -1;
+        return SPS30_value<float>(error(SPS30_ERROR_PARAMETER));
     }
 
     // If the value has already been read.
     if (_reported[value])
     {
         // Get new values
-        if (get_values(&v) != 0)
+        SPS30_status status = get_values(&_values);
+        if (!status)
         {
-            return -1;
+            return SPS30_value<float>(status);
         }
         memset(_reported, 0, sizeof(_reported));
     }
 
     _reported[value] = 1;
 
-    switch (value)
+    float *values = &_values.MassPM1; // The struct holds the values in the order of the enum.
+
+    return SPS30_value<float>(SPS30_status(), values[value - MassPM1]);
+}
+
+// response_wait returns how long to wait between sending a command and reading the response.
+uint8_t SPS30::response_wait(uint8_t command)
+{
+    if (command >= NUMBER_OF_COMMANDS || _latency[command] == LATENCY_UNKNOWN)
+    {
+        return RX_DELAY_MS;
+    }
+
+    return _latency[command];
+}
+
+// response_time_out returns how long to wait for a response before giving up.
+// Once the latency of a command is known the time out shrinks to twice the latency plus a margin.
+uint16_t SPS30::response_time_out(uint8_t command)
+{
+    if (command >= NUMBER_OF_COMMANDS || _latency[command] == LATENCY_UNKNOWN)
     {
-    case MassPM1:
-        return v.MassPM1;
-    case MassPM2:
-        return v.MassPM2;
-    case MassPM4:
-        return v.MassPM4;
-    case MassPM10:
-        return v.MassPM10;
-    case NumPM0:
-        return v.NumPM0;
-    case NumPM1:
-        return v.NumPM1;
-    case NumPM2:
-        return v.NumPM2;
-    case NumPM4:
-        return v.NumPM4;
-    case NumPM10:
-        return v.NumPM10;
-    case PartSize:
-        return v.PartSize;
+        return TIME_OUT;
     }
+
+    uint16_t time_out = 2 * _latency[command] + LATENCY_MARGIN_MS;
+
+    return time_out < TIME_OUT ? time_out : TIME_OUT;
 }
 
+// update_latency folds a measured response time into the learned latency of a command.
+void SPS30::update_latency(uint8_t command, uint32_t elapsed)
+{
+    if (command >= NUMBER_OF_COMMANDS)
+    {
+        return;
+    }
+
+    if (elapsed >= LATENCY_UNKNOWN)
+    {
+        elapsed = LATENCY_UNKNOWN - 1;
+    }
+
+    if (_latency[command] == LATENCY_UNKNOWN)
+    {
+        _latency[command] = elapsed;
+    }
+    else
+    {
+        _latency[command] = (3 * (uint16_t)_latency[command] + elapsed + 2) / 4; // Moving average with a weight of 1/4.
+    }
+
+    if (_latency[command] < latency_floor(command))
+    {
+        _latency[command] = latency_floor(command);
+    }
+}
+
+// latency_floor returns the lowest latency a command is given, so fast answers can't shrink the time out to the margin alone.
+// It is the execution time from the datasheet for the commands that have one.
+uint8_t SPS30::latency_floor(uint8_t command)
+{
+    switch (command)
+    {
+    case START_MEASUREMENT:
+    case STOP_MEASUREMENT:
+        return 20;
+    case SLEEP:
+    case WAKE_UP:
+    case START_FAN_CLEANING:
+        return 5;
+    case RESET:
+        return 100;
+    }
+
+    return LATENCY_MIN_MS;
+}
+
+#ifndef SPS30_NO_I2C
 boolean SPS30::I2C_send_command(Message *response, uint8_t command, uint32_t parameter)
 {
-    I2C_create_command(response, command, parameter);
+    int32_t remaining = _ready_time - millis();
+
+    if (remaining > 0) // Wait until the previous command has been executed.
+    {
+        delay(remaining);
+    }
+
+    if (_mux != NULL && !_mux->select(_channel))
+    {
+        _last_error = SPS30_ERROR_NACK;
+        return false;
+    }
+
+    PROFILE_BEGIN();
+
+    if (!I2C_create_command(response, command, parameter))
+    {
+        _last_error = SPS30_ERROR_COMMAND;
+        return false;
+    }
+
+    PROFILE_MARK(PROFILE_BUILD);
 
     if (!I2C_send(response))
     {
+        _latency[command] = LATENCY_UNKNOWN;
         return false;
     }
 
-    delay(RX_DELAY_MS); // Give the SPS30 some time to respond
+    PROFILE_MARK(PROFILE_TX);
 
-    if (response->read_length != 0)
+    uint32_t start_time = millis();
+
+    if (response->read_length == 0)
     {
-        if (!I2C_read(response))
-        {
-            return false;
-        }
+        // Nothing to read, only the next command has to wait for the execution of this one.
+        _ready_time = start_time + RX_DELAY_MS;
+        return true;
+    }
+
+    uint8_t wait = response_wait(command);
+    delay(wait); // Give the SPS30 some time to respond
+
+    if (!I2C_read(response, response_time_out(command)))
+    {
+        _latency[command] = LATENCY_UNKNOWN; // Fall back to the defaults.
+        return false;
+    }
+
+    uint32_t elapsed = millis() - start_time;
+
+    if (elapsed <= (uint32_t)wait + 1)
+    {
+        // The response was already there, try a shorter wait next time.
+        _latency[command] = wait / 2 > latency_floor(command) ? wait / 2 : latency_floor(command);
+    }
+    else
+    {
+        update_latency(command, elapsed);
     }
 
     return true;
 }
 
-boolean SPS30::I2C_read(Message *message)
+boolean SPS30::I2C_read(Message *message, uint16_t time_out)
 {
-    // Request amount data from the sensor with CRC's.
-    _i2c->requestFrom(message->address, (uint8_t)(message->read_length / 2 * 3));
+    uint32_t start_time = millis();
+
+    // Request amount data from the sensor with CRC's, the sensor doesn't acknowledge until it is ready.
+    while (_i2c->requestFrom((uint8_t)message->address, (uint8_t)(message->read_length / 2 * 3)) == 0)
+    {
+        if (millis() - start_time > time_out)
+        {
+            if (_SPS30_debug)
+            {
+                _debug->println("Error: TimeOut waiting for the I2C response");
+            }
+            _last_error = SPS30_ERROR_TIMEOUT;
+            return false;
+        }
+
+        delay(1);
+    }
+
+    PROFILE_MARK(PROFILE_WAIT);
 
     int i = 0;
     uint8_t data[3];
@@ -370,10 +973,9 @@ boolean SPS30::I2C_read(Message *message)
 
     while (_i2c->available())
     {
-        _debug->print("HI");
         data[i++] = _i2c->read();
 
-        if (i = 3)
+        if (i == 3) // Every 2 data bytes are followed by their CRC.
         {
             uint8_t crc = I2C_calculate_CRC(data);
             if (data[2] != crc)
@@ -385,6 +987,7 @@ boolean SPS30::I2C_read(Message *message)
                     _debug->print(" calculated ");
                     _debug->println(crc);
                 }
+                _last_error = SPS30_ERROR_CRC;
                 return false;
             }
 
@@ -393,19 +996,22 @@ boolean SPS30::I2C_read(Message *message)
 
             i = 0;
 
-            if (message->length >= message->read_length)
+            if (message->length >= message->read_length || message->length + 2 > MAX_DATA_LENGTH)
             {
                 break;
             }
         }
     }
 
+    PROFILE_MARK(PROFILE_RX);
+
     if (message->length == 0)
     {
         if (_SPS30_debug)
         {
             _debug->println("Error: Received NO bytes");
         }
+        _last_error = SPS30_ERROR_LENGTH;
         return false;
     }
 
@@ -422,6 +1028,7 @@ boolean SPS30::I2C_read(Message *message)
         _debug->println(message->length);
     }
 
+    _last_error = SPS30_ERROR_LENGTH;
     return false;
 }
 
@@ -446,10 +1053,7 @@ boolean SPS30::I2C_send(Message *message)
     if (message->command == I2C_WAKE_UP) // If the sensor needs to be woken up first a pulse needs to be send.
     {
         _i2c->beginTransmission(message->address);
-        if (!_i2c->endTransmission())
-        {
-            return false;
-        }
+        _i2c->endTransmission(); // A sleeping sensor doesn't acknowledge the pulse.
     }
 
     _i2c->beginTransmission(message->address);
@@ -457,8 +1061,9 @@ boolean SPS30::I2C_send(Message *message)
     _i2c->write((message->command) & 0xFF);
     _i2c->write(message->data, message->length);
 
-    if (!_i2c->endTransmission())
+    if (_i2c->endTransmission() != 0) // Anything else than 0 means the transmission failed.
     {
+        _last_error = SPS30_ERROR_NACK;
         return false;
     }
 
@@ -468,9 +1073,9 @@ boolean SPS30::I2C_send(Message *message)
 boolean SPS30::I2C_create_command(Message *message, uint8_t command, uint32_t parameter)
 {
     int i = 0;
-    message->address = 0x69;
+    message->address = I2C_ADDRESS;
     message->length = 0;
-    message->read_length = parameter;
+    message->read_length = 0;
 
     switch (command)
     {
@@ -493,7 +1098,7 @@ boolean SPS30::I2C_create_command(Message *message, uint8_t command, uint32_t pa
 
     case READ_MEASURED_VALUE:
         message->command = I2C_READ_MEASURED_VALUE;
-        message->read_length = 40;
+        message->read_length = I2C_MEASURED_VALUE_LENGTH;
         break;
 
     case SLEEP:
@@ -527,20 +1132,26 @@ boolean SPS30::I2C_create_command(Message *message, uint8_t command, uint32_t pa
 
     case READ_DEVICE_SERIAL_NUMBER:
         message->command = I2C_READ_SERIAL_NUMBER;
-        message->read_length = 32;
+        message->read_length = I2C_INFO_LENGTH;
         break;
 
     case READ_DEVICE_PRODUCT_TYPE:
         message->command = I2C_READ_PRODUCT_TYPE;
-        message->read_length = 32;
+        message->read_length = I2C_INFO_LENGTH;
         break;
 
     case READ_VERSION:
         message->command = I2C_READ_VERSION;
+        message->read_length = 2;
         break;
 
     case READ_STATUS_REGISTER:
         message->command = I2C_READ_DEVICE_STATUS_REGISTER;
+        message->read_length = 4;
+        break;
+
+    case CLEAR_STATUS_REGISTER:
+        message->command = I2C_CLEAR_DEVICE_STATUS_REGISTER;
         break;
 
     case RESET:
@@ -575,7 +1186,9 @@ uint8_t SPS30::I2C_calculate_CRC(uint8_t *data)
 
     return crc;
 }
+#endif
 
+#ifndef SPS30_NO_UART
 // SHDLC_send_command sends a command and reads back the response into a Message struct.
 boolean SPS30::SHDLC_send_command(Message *response, uint8_t command, uint32_t parameter)
 {
@@ -584,137 +1197,186 @@ boolean SPS30::SHDLC_send_command(Message *response, uint8_t command, uint32_t p
         return true;
     }
 
-    SHDLC_create_command(response, command, parameter);
+    PROFILE_BEGIN();
+
+    if (!SHDLC_create_command(response, command, parameter))
+    {
+        _last_error = SPS30_ERROR_COMMAND;
+        return false;
+    }
+
+    PROFILE_MARK(PROFILE_BUILD);
 
     _serial->flush(); // Flush anything pending on the serial port.
 
     if (!SHDLC_send(response)) // Send the created command.
     {
+        _latency[command] = LATENCY_UNKNOWN;
         return false;
     }
 
-    delay(RX_DELAY_MS); // Give the SPS30 some time to respond.
+    PROFILE_MARK(PROFILE_TX);
 
-    if (!SHDLC_read(response)) // Read the response of the SPS30.
+    // No fixed delay here, SHDLC_read polls until the trailer arrives or the (learned) time out expires.
+    uint32_t start_time = millis();
+
+    if (!SHDLC_read(response, response_time_out(command))) // Read the response of the SPS30.
     {
+        _latency[command] = LATENCY_UNKNOWN; // Fall back to the defaults.
         return false;
     }
 
+    update_latency(command, millis() - start_time);
+
+    _last_state = response->state;
+
     if (response->state != 0) // Check the state response for errors.
     {
         if (_SPS30_debug)
         {
-            _debug->print(response->data[SHDLC_STATE_BYTE], HEX);
+            _debug->print(response->state, HEX);
             _debug->println(" : state error");
         }
+
+        _last_error = decode_state(response->state);
+        if (_last_error != SPS30_OK)
+        {
+            return false;
+        }
     }
 
     return true;
 }
 
-// serial_to_buffer reads the serial input into the buffer and performs byte unstuffing.
-boolean SPS30::SHDLC_read(Message *response)
+// SHDLC_read reads the serial input and unstuffs it in place into the response, without an intermediate buffer.
+boolean SPS30::SHDLC_read(Message *response, uint16_t time_out)
 {
-    uint8_t buffer[MAX_RECEIVE_BUFFER_LENGTH];
-
     uint32_t start_time = millis();
     boolean byte_stuffing = false;
-    boolean header_received = false;
-
-    uint8_t i = 0;
-    uint8_t buffer_index = 0;
+    uint8_t i = 0; // Position in the unstuffed frame, 0 is the header.
 
-    while (!header_received) // Read the input stream until the last SHDLC_HEADER.
+    for (;;) // Read the input stream until the trailing SHDLC_HEADER.
     {
-        if (millis() - start_time > TIME_OUT) // Prevent deadlock by timing out after a while.
+        if (millis() - start_time > time_out) // Prevent deadlock by timing out after a while.
         {
-            if (_SPS30_debug > 1)
+            if (_SPS30_debug)
             {
                 _debug->print("TimeOut during reading byte ");
                 _debug->println(i);
             }
 
+            _last_error = SPS30_ERROR_TIMEOUT;
             return false;
         }
 
-        if (_serial->available())
+        if (!_serial->available())
         {
-            buffer[i] = _serial->read();
+            continue;
+        }
 
-            if (i == 0) // If it is the first byte.
-            {
-                if (buffer[i] != SHDLC_HEADER) // Check if the received byte is the SHDLC header byte.
-                {
+        uint8_t value = _serial->read();
 
-                    if (_SPS30_debug > 1)
-                    {
-                        _debug->print("Incorrect Header-> Expected 0x7E got ");
-                        _debug->println(buffer[i]);
-                    }
+        if (i == 0) // If it is the first byte.
+        {
+            PROFILE_MARK(PROFILE_WAIT);
 
-                    return 0;
-                }
-            }
-            else // Else parse the bytes.
+            if (value != SHDLC_HEADER) // Check if the received byte is the SHDLC header byte.
             {
-                if (buffer[i] == SHDLC_STUFFING_BYTE) // If the received byte is a stuffing byte.
-                {
-                    i--;                  // Remove the stuffing byte.
-                    byte_stuffing = true; // And the next byte should be unstuffed.
-                }
-                else if (byte_stuffing)
-                {
-                    buffer[i] = byte_unstuffing(buffer[i]);
-                    byte_stuffing = false;
-                }
-                else if (buffer[i] == SHDLC_HEADER) // If a trailer byte is received stop the receiving.
+                if (_SPS30_debug)
                 {
-                    buffer_index = i;
-
-                    if (_SPS30_debug)
-                    {
-                        _debug->print("Received: ");
-                        for (i = 0; i <= buffer_index; i++)
-                        {
-                            _debug->print(buffer[i], HEX);
-                            _debug->print(" ");
-                        }
-                        _debug->print("length: ");
-                        _debug->println(buffer_index);
-                    }
-
-                    // If a board can not handle 115K you get uncontrolled input that can result in short or wrong messages.
-                    if (buffer_index < 3)
-                    {
-                        return false;
-                    }
-
-                    header_received = true;
-                    break;
+                    _debug->print("Incorrect Header-> Expected 0x7E got ");
+                    _debug->println(value);
                 }
+
+                _last_error = SPS30_ERROR_HEADER;
+                return false;
             }
 
             i++;
+            continue;
+        }
 
-            if (i > MAX_RECEIVE_BUFFER_LENGTH)
+        if (byte_stuffing)
+        {
+            if (!byte_unstuffing(&value)) // Only 4 values can follow a stuffing byte.
+            {
+                _last_error = SPS30_ERROR_FRAMING;
+                return false;
+            }
+            byte_stuffing = false;
+        }
+        else if (value == SHDLC_STUFFING_BYTE) // The next byte should be unstuffed.
+        {
+            byte_stuffing = true;
+            continue;
+        }
+        else if (value == SHDLC_HEADER) // If a trailer byte is received stop the receiving.
+        {
+            break;
+        }
+
+        switch (i)
+        {
+        case SHDLC_ADDRESS_BYTE:
+            response->address = value;
+            break;
+        case SHDLC_COMMAND_BYTE:
+            response->command = value;
+            break;
+        case SHDLC_STATE_BYTE:
+            response->state = value;
+            break;
+        case SHDLC_LENGTH_BYTE:
+            response->length = value;
+            break;
+        default:
+            if (i - SHDLC_DATA_BYTE > MAX_DATA_LENGTH) // Data and CRC have to fit the message.
             {
                 if (_SPS30_debug)
                 {
                     _debug->println("Receive buffer full");
                 }
+                _last_error = SPS30_ERROR_LENGTH;
                 return false;
             }
+            response->data[i - SHDLC_DATA_BYTE] = value;
+            break;
         }
+
+        i++;
     }
 
-    response->address = buffer[SHDLC_ADDRESS_BYTE];
-    response->command = buffer[SHDLC_COMMAND_BYTE];
-    response->state = buffer[SHDLC_STATE_BYTE];
-    response->length = buffer[SHDLC_LENGTH_BYTE];
+    PROFILE_MARK(PROFILE_RX);
+
+    if (_SPS30_debug)
+    {
+        _debug->print("Received: ");
+        _debug->print(response->address, HEX);
+        _debug->print(" ");
+        _debug->print(response->command, HEX);
+        _debug->print(" ");
+        _debug->print(response->state, HEX);
+        _debug->print(" ");
+        for (uint8_t j = 0; j + SHDLC_DATA_BYTE < i; j++)
+        {
+            _debug->print(response->data[j], HEX);
+            _debug->print(" ");
+        }
+        _debug->print("length: ");
+        _debug->println(i);
+    }
 
-    for (int i = 0; i < response->length + 1; i++)
+    // The length byte has to match the received bytes: header, 4 fixed bytes, data and CRC.
+    // If a board can not handle 115K you get uncontrolled input that can result in short or wrong messages.
+    if (i <= SHDLC_DATA_BYTE || response->length > MAX_DATA_LENGTH || i != SHDLC_DATA_BYTE + response->length + 1)
     {
-        response->data[i] = buffer[SHDLC_DATA_BYTE + i];
+        if (_SPS30_debug)
+        {
+            _debug->print("Length error-> received bytes ");
+            _debug->println(i);
+        }
+        _last_error = SPS30_ERROR_LENGTH;
+        return false;
     }
 
     uint8_t crc = SHDLC_calculate_CRC(response, true); // Check the CRC.
@@ -728,9 +1390,12 @@ boolean SPS30::SHDLC_read(Message *response)
             _debug->print(", got ");
             _debug->println(crc, HEX);
         }
+        _last_error = SPS30_ERROR_CRC;
         return false;
     }
 
+    PROFILE_MARK(PROFILE_CRC);
+
     return true;
 }
 
@@ -763,13 +1428,13 @@ boolean SPS30::SHDLC_send(Message *message)
     }
 
     _serial->write(SHDLC_HEADER);
-    _serial->write(message->address & 0x00FF);
-    _serial->write(message->command & 0x00FF);
-    _serial->write(message->length);
+    byte_stuffing(message->address);
+    byte_stuffing(message->command);
+    byte_stuffing(message->length);
 
-    for (uint8_t i = 0; i < message->length + 1; i++) // Transmit all the data + CRC.
+    for (uint8_t i = 0; i < message->length + 1; i++) // Transmit all the data + CRC, stuffed on the way out.
     {
-        _serial->write(message->data[i]); // Send all the bytes over the set serial.
+        byte_stuffing(message->data[i]);
     }
 
     _serial->write(SHDLC_HEADER);
@@ -781,7 +1446,6 @@ boolean SPS30::SHDLC_send(Message *message)
 boolean SPS30::SHDLC_create_command(Message *message, uint8_t command, uint32_t parameter)
 {
     int i = 0;
-    uint8_t tmp;
 
     message->address = 0;
     message->length = 0;
@@ -826,14 +1490,10 @@ boolean SPS30::SHDLC_create_command(Message *message, uint8_t command, uint32_t
         message->length = 5;    // Add the data length.
         message->data[i++] = 0; // Add a subcommand, this value must be set to 0.
 
-        tmp = parameter >> 24 & 0xFF; // Add the (byte stuffed) parameter.
-        i = byte_stuffing(message->data, tmp, i);
-        tmp = parameter >> 16 & 0xFF;
-        i = byte_stuffing(message->data, tmp, i);
-        tmp = parameter >> 8 & 0xFF;
-        i = byte_stuffing(message->data, tmp, i);
-        tmp = parameter & 0xFF;
-        i = byte_stuffing(message->data, tmp, i);
+        message->data[i++] = parameter >> 24 & 0xFF; // Add the parameter, it is stuffed when sent.
+        message->data[i++] = parameter >> 16 & 0xFF;
+        message->data[i++] = parameter >> 8 & 0xFF;
+        message->data[i++] = parameter & 0xFF;
         break;
 
     case READ_DEVICE_PRODUCT_TYPE:
@@ -866,9 +1526,8 @@ boolean SPS30::SHDLC_create_command(Message *message, uint8_t command, uint32_t
         return false;
     }
 
-    // Add the CRC and check it for byte stuffing.
-    tmp = SHDLC_calculate_CRC(message, false);
-    i = byte_stuffing(message->data, tmp, i);
+    // Add the CRC over the unstuffed bytes.
+    message->data[message->length] = SHDLC_calculate_CRC(message, false);
 
     return true;
 }
@@ -895,8 +1554,8 @@ uint8_t SPS30::SHDLC_calculate_CRC(Message *message, boolean received)
     return ~(crc & 0xff);
 }
 
-// byte_stuffing checks if a byte needs stuffing and stuffs it.
-uint8_t SPS30::byte_stuffing(uint8_t *buffer, uint8_t value, uint8_t offset)
+// byte_stuffing writes a byte to the serial port, a special byte as the stuffing byte and its replacement.
+void SPS30::byte_stuffing(uint8_t value)
 {
     uint8_t x = 0;
 
@@ -920,50 +1579,72 @@ uint8_t SPS30::byte_stuffing(uint8_t *buffer, uint8_t value, uint8_t offset)
     }
 
     if (x == 0)
-        buffer[offset++] = value;
+        _serial->write(value);
     else
     {
-        buffer[offset++] = 0x7D;
-        buffer[offset++] = x;
+        _serial->write(SHDLC_STUFFING_BYTE);
+        _serial->write(x);
     }
-
-    return offset;
 }
 
-// byte_unstuffing unstuffs stuffed bytes.
-uint8_t SPS30::byte_unstuffing(uint8_t value)
+// byte_unstuffing unstuffs a stuffed byte in place, it returns false if the byte can't be a stuffed byte.
+boolean SPS30::byte_unstuffing(uint8_t *value)
 {
-    switch (value)
+    switch (*value)
     {
     case 0x31:
-        return (0x11);
+        *value = 0x11;
+        return true;
     case 0x33:
-        return (0x13);
+        *value = 0x13;
+        return true;
     case 0x5d:
-        return (0x7d);
+        *value = 0x7d;
+        return true;
     case 0x5e:
-        return (0x7e);
+        *value = 0x7e;
+        return true;
 
     default:
         if (_SPS30_debug)
         {
             _debug->print("Incorrect byte Unstuffing-> Got: ");
-            _debug->println(value);
+            _debug->println(*value);
         }
-        return NULL;
+        return false;
     }
 }
+#endif
 
-// byte_to_float translates a byte array to a float.
-float SPS30::byte_to_float(uint8_t *buffer)
+// read_be32 reads a big endian 32 bit word from the (unaligned) buffer.
+static inline uint32_t read_be32(const uint8_t *buffer)
 {
+#if defined(__GNUC__) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
     uint32_t value;
-    float float_value;
+    memcpy(&value, buffer, sizeof(value)); // Compiles to a single (unaligned) load where the target allows it.
+    return __builtin_bswap32(value);
+#else
+    return ((uint32_t)buffer[0] << 24) | ((uint32_t)buffer[1] << 16) | ((uint32_t)buffer[2] << 8) | buffer[3];
+#endif
+}
 
-    for (byte i = 0; i < 4; i++)
+// decode_measurements byte swaps count big endian floats from the buffer directly into the struct.
+void SPS30::decode_measurements(const uint8_t *buffer, uint8_t count, Measurements *v)
+{
+    uint8_t *out = (uint8_t *)v;
+
+    for (uint8_t i = 0; i < count; i++)
     {
-        value += (uint32_t)buffer[3 - i] << (i * 8);
+        uint32_t value = read_be32(&buffer[i * 4]);
+        memcpy(&out[i * 4], &value, sizeof(value));
     }
+}
+
+// byte_to_float translates a byte array to a float.
+float SPS30::byte_to_float(uint8_t *buffer)
+{
+    uint32_t value = read_be32(buffer);
+    float float_value;
 
     memcpy(&float_value, &value, sizeof(float_value));
 
@@ -973,12 +1654,5 @@ float SPS30::byte_to_float(uint8_t *buffer)
 // byte_to_U32 translates a byte array to an uint32_t.
 uint32_t SPS30::byte_to_U32(uint8_t *buffer)
 {
-    uint32_t value;
-
-    for (byte i = 0; i < 4; i++)
-    {
-        value += (uint32_t)buffer[3 - i] << (i * 8);
-    }
-
-    return value;
-}
\ No newline at end of file
+    return read_be32(buffer);
+}
@@ -25,15 +25,50 @@
 #ifndef SPS30_H
 #define SPS30_H
 
+// #define SPS30_NO_I2C  // Uncomment to leave the I2C transport (and the Wire library) out of the build
+// #define SPS30_NO_UART // Uncomment to leave the UART transport out of the build
+
+#if defined SPS30_NO_I2C && defined SPS30_NO_UART
+#error "SPS30: at least one of the transports has to be enabled"
+#endif
+
 #include "Arduino.h" // Needed for Stream
+#ifndef SPS30_NO_I2C
 #include <Wire.h>
+#endif
+
+// #define SPS30_PROFILING // Uncomment to time every phase of a transaction, costs nothing when disabled
+
+#if defined SPS30_PROFILING && !defined SPS30_PROFILE_CLOCK // A host stub can define its own clock.
+#if defined ESP32 || defined ESP8266
+#define SPS30_PROFILE_CLOCK() ESP.getCycleCount() // CCOUNT register
+#elif defined __ARM_ARCH_7M__ || defined __ARM_ARCH_7EM__
+#define SPS30_DWT_CYCCNT (*(volatile uint32_t *)0xE0001004) // Cortex-M3/M4/M7 DWT cycle counter
+#define SPS30_PROFILE_CLOCK() SPS30_DWT_CYCCNT
+#else
+#define SPS30_PROFILE_CLOCK() micros()
+#endif
+#endif
+
+#ifdef SPS30_PROFILING
+#define PROFILE_BEGIN() profile_begin()
+#define PROFILE_MARK(phase) profile_mark(phase)
+#else
+#define PROFILE_BEGIN()
+#define PROFILE_MARK(phase)
+#endif
+
+#define PROFILE_BUCKETS 16 // Bucket n counts the phases that took 2^n up to 2^(n+1) clock ticks
 
-#define MAX_RECEIVE_BUFFER_LENGTH 80 // ~Max response length with byte stuffing
-#define MAX_DATA_LENGTH 40           // Max data length = 40
+#ifndef MAX_DATA_LENGTH
+#define MAX_DATA_LENGTH 40 // Largest response of all commands: the measured values
+#endif
 
 #define I2C_CRC_POLYNOMIAL 0x31
 #define I2C_CRC_INITIALIZATION 0xFF
 
+#define I2C_ADDRESS 0x69
+
 #define I2C_LENGTH 32
 
 #if defined BUFFER_LENGTH // Arduino  & ESP8266 & Softwire
@@ -51,6 +86,12 @@
 #define I2C_LENGTH 256
 #endif
 
+// Measured value bytes that fit the I2C buffer, every 2 data bytes are followed by a CRC.
+#define I2C_MEASURED_VALUE_LENGTH (I2C_LENGTH >= 60 ? 40 : ((I2C_LENGTH / 3 * 2) & ~3))
+
+// Serial number and product type bytes that fit the I2C buffer, the 16 characters of the serial number fit even 32 bytes.
+#define I2C_INFO_LENGTH (I2C_LENGTH >= 48 ? 32 : (I2C_LENGTH / 3 * 2))
+
 // Struct containing sensor values
 typedef struct Measurements
 {
@@ -66,6 +107,9 @@ typedef struct Measurements
     float PartSize; // Typical Particle Size [μm]
 };
 
+// The measured values are decoded in one pass, so the struct must be laid out like the response.
+static_assert(sizeof(Measurements) == 10 * sizeof(float), "Measurements must hold exactly ten floats");
+
 // The message struct contains all the relevant fields for I2C and SHDLC messages to the SPS30
 typedef struct Message
 {
@@ -74,7 +118,7 @@ typedef struct Message
     uint8_t state;
     uint8_t length;
     uint8_t read_length;
-    uint8_t data[MAX_DATA_LENGTH];
+    uint8_t data[MAX_DATA_LENGTH + 1]; // Room for the SHDLC CRC behind the data
 };
 
 // The version struct contains all the version information.
@@ -87,6 +131,85 @@ typedef struct Version
     uint8_t SHDLC_minor;
 };
 
+// The device health struct is a decoded snapshot of the status register.
+struct DeviceHealth
+{
+    uint32_t status_register; // Raw register, including the bits that aren't documented
+    boolean speed;            // Fan speed more than 10% off the target, a warning
+    boolean laser;            // Laser current out of range
+    boolean fan;              // Fan switched on but not turning
+    uint32_t time;            // millis() at which the register was read
+};
+
+// The retry policy determines how send_command recovers from transient communication errors.
+struct RetryPolicy
+{
+    uint8_t max_attempts; // Attempts per command, 1 disables retrying
+    uint16_t backoff_ms;  // Wait before the first retry, doubled on every next retry
+    boolean resync;       // Drain the UART or send an I2C wake pulse before retrying
+};
+
+// Errors reported by the library, the SHDLC state errors are decoded from the state byte.
+enum SPS30_error
+{
+    SPS30_OK,
+    SPS30_ERROR_TIMEOUT,     // No (complete) response within the time out
+    SPS30_ERROR_HEADER,      // The response didn't start with a SHDLC header
+    SPS30_ERROR_FRAMING,     // The response contains an invalid stuffed byte
+    SPS30_ERROR_CRC,         // CRC mismatch in the response
+    SPS30_ERROR_LENGTH,      // The response is too short or too long
+    SPS30_ERROR_NACK,        // The I2C transmission was not acknowledged
+    SPS30_ERROR_NOT_STARTED, // The command requires a started measurement
+    SPS30_ERROR_COMMAND,     // The command is not available on this interface
+    SPS30_ERROR_PARAMETER,   // An argument of the called function is out of range
+    SPS30_ERROR_CLEANING,    // The values are masked because the fan is being cleaned
+    SPS30_ERROR_UNSUPPORTED, // The firmware of the sensor doesn't support the command
+    SPS30_ERROR_NO_SENSOR,   // None of the combined sensors has usable measurements
+
+    SPS30_ERROR_STATE_LENGTH,      // 0x01 Wrong data length for this command
+    SPS30_ERROR_STATE_COMMAND,     // 0x02 Unknown command
+    SPS30_ERROR_STATE_ACCESS,      // 0x03 No access right for command
+    SPS30_ERROR_STATE_PARAMETER,   // 0x04 Illegal command parameter or parameter out of range
+    SPS30_ERROR_STATE_ARGUMENT,    // 0x28 Internal function argument out of range
+    SPS30_ERROR_STATE_NOT_ALLOWED, // 0x43 Command not allowed in current state
+    SPS30_ERROR_STATE_UNKNOWN      // Any other non zero state byte
+};
+
+// SPS30_status is returned by every command, it converts to true when the command succeeded.
+struct SPS30_status
+{
+    SPS30_error error; // SPS30_OK or the reason the command failed
+    uint8_t state;     // SHDLC state byte of the last response
+
+    SPS30_status(SPS30_error error = SPS30_OK, uint8_t state = 0) : error(error), state(state) {}
+
+    boolean ok() const { return error == SPS30_OK; }
+    operator bool() const { return ok(); }
+};
+
+// SPS30_value carries the value read by a command together with the status of that command.
+// Its conversion to bool is explicit, so float pm = get_mass_PM2() doesn't compile instead of giving 1.0, use .value.
+template <typename T>
+struct SPS30_value : public SPS30_status
+{
+    T value; // Only valid when ok()
+
+    SPS30_value(SPS30_status status = SPS30_status(), T value = T()) : SPS30_status(status), value(value) {}
+
+    explicit operator bool() const { return ok(); }
+};
+
+// A boolean value like data ready would be mistaken for the status in if (...), so both must be named: ok() and value.
+template <>
+struct SPS30_value<boolean> : public SPS30_status
+{
+    boolean value; // Only valid when ok()
+
+    SPS30_value(SPS30_status status = SPS30_status(), boolean value = false) : SPS30_status(status), value(value) {}
+
+    explicit operator bool() const = delete;
+};
+
 // Enum for retrieval of single values
 enum values
 {
@@ -102,6 +225,18 @@ enum values
     PartSize
 };
 
+// Phases of a transaction timed by the profiler.
+enum profile_phases
+{
+    PROFILE_BUILD,  // Creating the command frame
+    PROFILE_TX,     // Transmitting the frame
+    PROFILE_WAIT,   // Waiting for the start of the response
+    PROFILE_RX,     // Receiving the response (I2C includes the CRC checks)
+    PROFILE_CRC,    // Checking the SHDLC CRC
+    PROFILE_DECODE, // Decoding the measured values
+    PROFILE_PHASES
+};
+
 enum status
 {
     SPEED,
@@ -109,6 +244,14 @@ enum status
     FAN
 };
 
+// Features that depend on the firmware version.
+enum capabilities
+{
+    CAPABILITY_SLEEP = 0x01,           // Sleep and wake up, firmware 2.0
+    CAPABILITY_STATUS_REGISTER = 0x02, // Device status register, firmware 2.2
+    CAPABILITY_ALL = 0x03              // Assumed as long as the version is unknown
+};
+
 enum commands
 {
     START_MEASUREMENT,
@@ -125,7 +268,9 @@ enum commands
     READ_STATUS_REGISTER,
     AUTO_CLEANING_INTERVAL,
     READ_AUTO_CLEANING,
-    WRITE_AUTO_CLEANING
+    WRITE_AUTO_CLEANING,
+    CLEAR_STATUS_REGISTER, // I2C only, SHDLC clears while reading
+    NUMBER_OF_COMMANDS
 };
 
 enum SHDLC_commands
@@ -175,90 +320,227 @@ enum I2C_commands
     I2C_RESET = 0xD304
 };
 
+#define STATUS_SPEED_BIT 21 // Bits of the status register
+#define STATUS_LASER_BIT 5
+#define STATUS_FAN_BIT 4
+
+#define MEASUREMENT_INTERVAL_MS 1000 // The sensor updates its measured values every second
+
 #define TIME_OUT 200   // Timeout to prevent deadlock read
 #define RX_DELAY_MS 20 // Wait between write and read
 
-class SPS30
+#define RETRY_ATTEMPTS 3    // Default attempts per command
+#define RETRY_BACKOFF_MS 10 // Default wait before the first retry
+
+#define LATENCY_MARGIN_MS 5   // Safety margin added to a learned response latency
+#define LATENCY_UNKNOWN 0xFF  // No response latency learned yet, use the defaults
+#define LATENCY_MIN_MS 2      // A learned latency never goes below this, or below the execution time of the command
+
+#ifndef SPS30_NO_I2C
+#define MUX_NO_CHANNEL 0xFF // The selected channel of the multiplexer is unknown
+
+#ifndef MUX_MAX_BUSES
+#define MUX_MAX_BUSES 4 // I2C buses with multiplexers, a select on one more bus fails
+#endif
+
+class SPS30;
+
+// The mux class represents a TCA9548A style I2C multiplexer, it remembers the selected channel so it is only switched when needed.
+// Share one object between all sensors behind the same multiplexer. With several multiplexers on one bus, only
+// one has a channel switched on at a time: the selection is kept per bus and the previous one is switched off first.
+class SPS30_mux
 {
 public:
-    SPS30(void);
+    SPS30_mux(TwoWire *the_wire, uint8_t address = 0x70);
+    ~SPS30_mux();
 
-    boolean begin(Stream *the_uart = &Serial1); // If user doesn't specify Serial1 will be used
-    boolean begin(TwoWire *the_wire);
+    boolean select(uint8_t channel);
+    void invalidate() { _channel = MUX_NO_CHANNEL; }
 
-    void enable_debugging(Stream *debug = &Serial);
-    void disable_debugging();
+    TwoWire *get_wire() { return _wire; }
+    uint32_t get_switch_count() { return _switches; }
+
+    static void order(SPS30 **sensors, uint8_t count);
 
-    boolean probe();
-    boolean reset();
-    boolean start();
-    boolean stop();
-    boolean clean();
-    boolean sleep();
-    boolean wake_up();
+private:
+    TwoWire *_wire;
+    uint8_t _address;
+    uint8_t _channel = MUX_NO_CHANNEL;
+    uint32_t _switches = 0; // Channel masks written to the multiplexer, switching off included
 
-    uint32_t get_auto_clean_interval();
-    boolean set_auto_clean_interval(uint32_t val);
+    boolean write(uint8_t channels);
+};
+#endif
+
+class SPS30
+{
+public:
+    SPS30(void);
 
-    boolean get_serial_number(char *ser, uint8_t len) { return get_device_info(SHDLC_READ_DEVICE_SERIAL_NUMBER, ser, len); }
-    boolean get_product_type(char *ser, uint8_t len) { return get_device_info(SHDLC_READ_DEVICE_PRODUCT_TYPE, ser, len); }
+#ifndef SPS30_NO_UART
+    SPS30_status begin(Stream *the_uart = &Serial1); // If user doesn't specify Serial1 will be used
+#endif
+#ifndef SPS30_NO_I2C
+    SPS30_status begin(TwoWire *the_wire);
+    SPS30_status begin(SPS30_mux *mux, uint8_t channel);
 
-    boolean read_version(Version *response);
+    SPS30_mux *get_mux() const { return _mux; }
+    uint8_t get_mux_channel() const { return _channel; }
+#endif
 
-    boolean read_speed_status(boolean *error, boolean clear = false) { return get_device_status(SPEED, error, clear); }
-    boolean read_fan_status(boolean *error, boolean clear = false) { return get_device_status(FAN, error, clear); }
-    boolean read_laser_status(boolean *error, boolean clear = false) { return get_device_status(LASER, error, clear); }
+    void enable_debugging(Stream *debug = &Serial);
+    void disable_debugging();
 
-    boolean get_values(Measurements *v);
+    SPS30_status probe();
+    SPS30_status reset();
+    SPS30_status start();
+    SPS30_status stop();
+    SPS30_status clean();
+    SPS30_status sleep();
+    SPS30_status wake_up();
+
+    SPS30_value<uint32_t> get_auto_clean_interval();
+    SPS30_status set_auto_clean_interval(uint32_t val);
+
+    SPS30_status get_serial_number(char *ser, uint8_t len) { return get_device_info(READ_DEVICE_SERIAL_NUMBER, ser, len); }
+    SPS30_status get_product_type(char *ser, uint8_t len) { return get_device_info(READ_DEVICE_PRODUCT_TYPE, ser, len); }
+
+    SPS30_status read_version(Version *response);
+    boolean supports(uint8_t capability);
+
+    SPS30_status read_speed_status(boolean *error, boolean clear = false) { return get_device_status(SPEED, error, clear); }
+    SPS30_status read_fan_status(boolean *error, boolean clear = false) { return get_device_status(FAN, error, clear); }
+    SPS30_status read_laser_status(boolean *error, boolean clear = false) { return get_device_status(LASER, error, clear); }
+
+    SPS30_status read_device_health(DeviceHealth *health, boolean clear = false);
+    boolean get_device_health(DeviceHealth *health);
+    void set_health_ratio(uint8_t ratio) { _health_ratio = ratio; }
+
+    boolean is_started() const { return _started; }
+    boolean has_data_ready() const { return i2c_mode(); } // Only I2C reads the flag, over UART read_data_ready guesses by the time
+    SPS30_value<boolean> read_data_ready();
+    SPS30_status get_values(Measurements *v);
+
+    SPS30_value<float> get_mass_PM1() { return (get_single_value(MassPM1)); }
+    SPS30_value<float> get_mass_PM2() { return (get_single_value(MassPM2)); }
+    SPS30_value<float> get_mass_PM4() { return (get_single_value(MassPM4)); }
+    SPS30_value<float> get_mass_PM10() { return (get_single_value(MassPM10)); }
+    SPS30_value<float> get_num_PM0() { return (get_single_value(NumPM0)); }
+    SPS30_value<float> get_num_PM1() { return (get_single_value(NumPM1)); }
+    SPS30_value<float> get_num_PM2() { return (get_single_value(NumPM2)); }
+    SPS30_value<float> get_num_PM4() { return (get_single_value(NumPM4)); }
+    SPS30_value<float> get_num_PM10() { return (get_single_value(NumPM10)); }
+    SPS30_value<float> get_part_size() { return (get_single_value(PartSize)); }
+
+    uint8_t get_response_latency(uint8_t command);
+
+#ifdef SPS30_PROFILING
+    const uint16_t *get_profile_histogram(uint8_t phase) { return phase < PROFILE_PHASES ? _profile[phase] : NULL; }
+    uint32_t get_profile_ticks(uint8_t phase) { return phase < PROFILE_PHASES ? _profile_ticks[phase] : 0; }
+    void clear_profile();
+#endif
 
-    float get_mass_PM1() { return (get_single_value(MassPM1)); }
-    float get_mass_PM2() { return (get_single_value(MassPM2)); }
-    float get_mass_PM4() { return (get_single_value(MassPM4)); }
-    float get_mass_PM10() { return (get_single_value(MassPM10)); }
-    float get_num_PM0() { return (get_single_value(NumPM0)); }
-    float get_num_PM1() { return (get_single_value(NumPM1)); }
-    float get_num_PM2() { return (get_single_value(NumPM2)); }
-    float get_num_PM4() { return (get_single_value(NumPM4)); }
-    float get_num_PM10() { return (get_single_value(NumPM10)); }
-    float get_part_size() { return (get_single_value(PartSize)); }
+    void set_retry_policy(RetryPolicy policy) { _retry_policy = policy; }
+    SPS30_error get_last_error() { return _last_error; }
+    uint8_t get_last_state() { return _last_state; }
+    uint32_t get_retry_count() { return _retries; }
+    uint32_t get_failure_count() { return _failures; }
+    void clear_retry_count() { _retries = _failures = 0; }
 
 private:
-    boolean _i2c_mode = false;       // If it is in I2C mode, it isn't in UART mode and vice versa
-    boolean _i2c_max_length = false; // Do we need to account for a small I2C buffer?
+    boolean _i2c_mode = false; // If it is in I2C mode, it isn't in UART mode and vice versa
 
     boolean _SPS30_debug = false; // Program debug level
     boolean _started = false;     // Indicate the measurement has started
     uint8_t _reported[11];        // Use as cache indicator single value
+    uint32_t _read_time = 0;      // Time of the last successful measured value read
+    Measurements _values;         // Values handed out one by one by get_single_value
+
+    Message _message; // Shared by all commands, responses are decoded in place
+
+    uint8_t _capabilities = CAPABILITY_ALL; // Features of the firmware
+    boolean _version_known = false;         // The capabilities have been detected
+
+    DeviceHealth _health;             // Last status register snapshot
+    boolean _health_valid = false;    // The snapshot has been read
+    uint8_t _health_ratio = 0;        // Read the snapshot with every n-th measurement, 0 disables it
+    uint8_t _health_count = 0;        // Measurements since the last snapshot
 
-    boolean send_command(Message *response, uint8_t command, uint32_t parameter = 0);
-    float get_single_value(uint8_t value);
-    boolean get_device_info(uint8_t command, char *ser, uint8_t len);
-    boolean get_device_status(uint8_t command, boolean *error, boolean clear);
+    uint8_t _latency[NUMBER_OF_COMMANDS]; // Learned response latency per command in ms
+    uint32_t _ready_time = 0;             // I2C: time at which the last command has been executed
 
+    RetryPolicy _retry_policy = {RETRY_ATTEMPTS, RETRY_BACKOFF_MS, true};
+    SPS30_error _last_error = SPS30_OK; // Error of the last command
+    uint8_t _last_state = 0;            // SHDLC state byte of the last response
+    uint32_t _retries = 0;              // Number of retried attempts
+    uint32_t _failures = 0;             // Number of commands that failed after all attempts
+
+#ifdef SPS30_PROFILING
+    uint16_t _profile[PROFILE_PHASES][PROFILE_BUCKETS]; // Histogram of the duration per phase
+    uint32_t _profile_ticks[PROFILE_PHASES];            // Total clock ticks spent per phase
+    uint32_t _profile_time;                             // Clock at the end of the previous phase
+
+    void profile_begin() { _profile_time = SPS30_PROFILE_CLOCK(); }
+    void profile_mark(uint8_t phase);
+#endif
+
+    SPS30_status send_command(uint8_t command, uint32_t parameter = 0);
+    SPS30_value<float> get_single_value(uint8_t value);
+    SPS30_status get_device_info(uint8_t command, char *ser, uint8_t len);
+    SPS30_status get_device_status(uint8_t command, boolean *error, boolean clear);
+
+    uint8_t response_wait(uint8_t command);
+    uint16_t response_time_out(uint8_t command);
+    void update_latency(uint8_t command, uint32_t elapsed);
+    uint8_t latency_floor(uint8_t command);
+
+    SPS30_status error(SPS30_error error);
+    boolean is_transient(SPS30_error error);
+    SPS30_error decode_state(uint8_t state);
+    void resync();
+
+    // With only one transport enabled the mode is a constant and the other code path is left out.
+#if defined SPS30_NO_I2C
+    boolean i2c_mode() const { return false; }
+#elif defined SPS30_NO_UART
+    boolean i2c_mode() const { return true; }
+#else
+    boolean i2c_mode() const { return _i2c_mode; }
+#endif
+
+#ifndef SPS30_NO_I2C
     //I2C functions
     boolean I2C_send_command(Message *response, uint8_t command, uint32_t parameter = 0);
-    boolean I2C_read(Message *message);
+    boolean I2C_read(Message *message, uint16_t time_out = TIME_OUT);
     boolean I2C_send(Message *message);
 
     boolean I2C_create_command(Message *message, uint8_t command, uint32_t parameter = 0);
     uint8_t I2C_calculate_CRC(uint8_t *data);
 
+    TwoWire *_i2c = NULL;
+    SPS30_mux *_mux = NULL; // Multiplexer in front of the sensor, if any
+    uint8_t _channel = 0;   // Channel of the multiplexer
+#endif
+
+#ifndef SPS30_NO_UART
     // SHDLC functions
     boolean SHDLC_send_command(Message *response, uint8_t command, uint32_t parameter = 0);
-    boolean SHDLC_read(Message *message);
+    boolean SHDLC_read(Message *message, uint16_t time_out = TIME_OUT);
     boolean SHDLC_send(Message *message);
 
     boolean SHDLC_create_command(Message *message, uint8_t command, uint32_t parameter = 0);
     uint8_t SHDLC_calculate_CRC(Message *message, boolean received);
 
-    uint8_t byte_stuffing(uint8_t *buffer, uint8_t value, uint8_t offset);
-    uint8_t byte_unstuffing(uint8_t value);
+    void byte_stuffing(uint8_t value);
+    boolean byte_unstuffing(uint8_t *value);
+
+    Stream *_serial = NULL;
+#endif
 
+    void decode_measurements(const uint8_t *buffer, uint8_t count, Measurements *v);
     float byte_to_float(uint8_t *buffer);
     uint32_t byte_to_U32(uint8_t *buffer);
 
-    Stream *_serial;
-    Stream *_debug;
-    TwoWire *_i2c;
+    Stream *_debug = NULL;
 };
 #endif
@@ -0,0 +1,291 @@
+/**
+ * SPS30 - Air quality Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_aqi.h"
+
+// Breakpoint tables, concentrations are given in tenths of μg/m3: {C low, C high, index low, index high}.
+struct Breakpoint
+{
+    uint16_t c_low;
+    uint16_t c_high;
+    uint16_t i_low;
+    uint16_t i_high;
+};
+
+// US EPA PM2.5 24 hour breakpoints (2024 revision).
+static const Breakpoint epa_pm2[] = {
+    {0, 90, 0, 50},
+    {91, 354, 51, 100},
+    {355, 554, 101, 150},
+    {555, 1254, 151, 200},
+    {1255, 2254, 201, 300},
+    {2255, 3254, 301, 500}};
+
+// US EPA PM10 24 hour breakpoints.
+static const Breakpoint epa_pm10[] = {
+    {0, 540, 0, 50},
+    {550, 1540, 51, 100},
+    {1550, 2540, 101, 150},
+    {2550, 3540, 151, 200},
+    {3550, 4240, 201, 300},
+    {4250, 6040, 301, 500}};
+
+// EU CAQI hourly grid for PM2.5.
+static const Breakpoint caqi_pm2[] = {
+    {0, 150, 0, 25},
+    {150, 300, 25, 50},
+    {300, 550, 50, 75},
+    {550, 1100, 75, 100}};
+
+// EU CAQI hourly grid for PM10.
+static const Breakpoint caqi_pm10[] = {
+    {0, 250, 0, 25},
+    {250, 500, 25, 50},
+    {500, 900, 50, 75},
+    {900, 1800, 75, 100}};
+
+// index_from_table interpolates the index of a concentration in tenths of μg/m3, it is capped at the top of the table.
+static uint16_t index_from_table(const Breakpoint *table, uint8_t rows, uint16_t concentration)
+{
+    for (uint8_t i = 0; i < rows; i++)
+    {
+        const Breakpoint *b = &table[i];
+
+        if (concentration <= b->c_high)
+        {
+            if (concentration < b->c_low) // In the gap between two rows.
+            {
+                concentration = b->c_low;
+            }
+
+            uint32_t range = (uint32_t)(b->i_high - b->i_low) * (concentration - b->c_low);
+            uint16_t span = b->c_high - b->c_low;
+
+            return b->i_low + (range + span / 2) / span;
+        }
+    }
+
+    return table[rows - 1].i_high;
+}
+
+// to_tenths converts a concentration to tenths of μg/m3 and truncates it to the given resolution in tenths.
+static uint16_t to_tenths(float concentration, uint16_t resolution)
+{
+    if (concentration <= 0)
+    {
+        return 0;
+    }
+
+    if (concentration >= 6500)
+    {
+        return 65000;
+    }
+
+    uint16_t tenths = concentration * 10;
+
+    return tenths - tenths % resolution;
+}
+
+SPS30_air_quality::SPS30_air_quality()
+{
+    clear();
+}
+
+// clear forgets all samples and events.
+void SPS30_air_quality::clear()
+{
+    memset(_hour, 0, sizeof(_hour));
+    memset(_day, 0, sizeof(_day));
+    _hour_slot = 0;
+    _day_slot = 0;
+    _hour_start = 0;
+    _day_start = 0;
+    _empty = true;
+    _has_event = false;
+}
+
+// add folds a sample into the hour and day buckets and checks for a dust event.
+// The buckets follow the time since the first sample, so they keep going when millis() wraps around after 49 days.
+uint8_t SPS30_air_quality::add(const Measurements *v, uint32_t now)
+{
+    if (_empty)
+    {
+        _hour_start = now;
+        _day_start = now;
+        _empty = false;
+    }
+
+    advance(_hour, AQ_HOUR_BUCKETS, &_hour_slot, &_hour_start, AQ_HOUR_BUCKET_MS, now);
+    advance(_day, AQ_DAY_BUCKETS, &_day_slot, &_day_start, AQ_DAY_BUCKET_MS, now);
+
+    // Take the baseline before this sample influences it.
+    uint32_t day_count;
+    float baseline = average(_day, AQ_DAY_BUCKETS, AQ_PM2, &day_count);
+    if (day_count < AQ_BASELINE_SAMPLES)
+    {
+        baseline = average(_hour, AQ_HOUR_BUCKETS, AQ_PM2, &day_count);
+    }
+
+    float values[AQ_CHANNELS] = {v->MassPM2, v->MassPM10, v->PartSize};
+    AirQualityBucket *hour = &_hour[_hour_slot % AQ_HOUR_BUCKETS];
+    AirQualityBucket *day = &_day[_day_slot % AQ_DAY_BUCKETS];
+
+    for (uint8_t c = 0; c < AQ_CHANNELS; c++)
+    {
+        hour->sum[c] += values[c];
+        day->sum[c] += values[c];
+    }
+    hour->count++;
+    day->count++;
+
+    if (day_count == 0) // Nothing to compare with yet.
+    {
+        return AQ_EVENT_NONE;
+    }
+
+    if (_has_event && _event.active)
+    {
+        if (v->MassPM2 > _event.peak)
+        {
+            _event.peak = v->MassPM2;
+        }
+
+        if (v->MassPM2 < _event.baseline + AQ_SPIKE_OFFSET) // Back near the baseline.
+        {
+            _event.end = now;
+            _event.active = false;
+            return AQ_EVENT_END;
+        }
+    }
+    else if (v->MassPM2 > baseline * AQ_SPIKE_FACTOR + AQ_SPIKE_OFFSET)
+    {
+        _event.start = now;
+        _event.end = 0;
+        _event.peak = v->MassPM2;
+        _event.baseline = baseline;
+        _event.active = true;
+        _has_event = true;
+        return AQ_EVENT_START;
+    }
+
+    return AQ_EVENT_NONE;
+}
+
+// get_average returns the rolling average of a channel over the last hour or day.
+float SPS30_air_quality::get_average(uint8_t channel, uint8_t period)
+{
+    if (channel >= AQ_CHANNELS)
+    {
+        return 0;
+    }
+
+    if (period == AQ_HOUR)
+    {
+        return average(_hour, AQ_HOUR_BUCKETS, channel);
+    }
+
+    return average(_day, AQ_DAY_BUCKETS, channel);
+}
+
+// get_us_aqi returns the US EPA AQI of the 24 hour PM2.5 and PM10 averages, whichever is worse.
+uint16_t SPS30_air_quality::get_us_aqi()
+{
+    uint16_t pm2 = index_from_table(epa_pm2, sizeof(epa_pm2) / sizeof(epa_pm2[0]), to_tenths(get_average(AQ_PM2, AQ_DAY), 1));
+    uint16_t pm10 = index_from_table(epa_pm10, sizeof(epa_pm10) / sizeof(epa_pm10[0]), to_tenths(get_average(AQ_PM10, AQ_DAY), 10));
+
+    return pm2 > pm10 ? pm2 : pm10;
+}
+
+// get_caqi returns the EU CAQI (background, hourly) of PM2.5 and PM10, whichever is worse. 100 means 100 or more.
+uint8_t SPS30_air_quality::get_caqi()
+{
+    uint16_t pm2 = index_from_table(caqi_pm2, sizeof(caqi_pm2) / sizeof(caqi_pm2[0]), to_tenths(get_average(AQ_PM2, AQ_HOUR), 1));
+    uint16_t pm10 = index_from_table(caqi_pm10, sizeof(caqi_pm10) / sizeof(caqi_pm10[0]), to_tenths(get_average(AQ_PM10, AQ_HOUR), 1));
+
+    return pm2 > pm10 ? pm2 : pm10;
+}
+
+// get_pm_ratio returns the hourly PM2.5/PM10 ratio, a low ratio points at coarse dust.
+float SPS30_air_quality::get_pm_ratio()
+{
+    float pm10 = get_average(AQ_PM10, AQ_HOUR);
+
+    return pm10 > 0 ? get_average(AQ_PM2, AQ_HOUR) / pm10 : 0;
+}
+
+// get_size_trend returns how much larger the particles of the last hour are than those of the last day [μm].
+float SPS30_air_quality::get_size_trend()
+{
+    return get_average(AQ_SIZE, AQ_HOUR) - get_average(AQ_SIZE, AQ_DAY);
+}
+
+// get_event returns the current or last dust event, false if there hasn't been one.
+boolean SPS30_air_quality::get_event(DustEvent *event)
+{
+    if (!_has_event)
+    {
+        return false;
+    }
+
+    *event = _event;
+    return true;
+}
+
+// advance moves a ring of buckets forward to the slot of now, the buckets that are skipped are emptied.
+// A time before the start of the newest bucket is added to it.
+void SPS30_air_quality::advance(AirQualityBucket *buckets, uint8_t length, uint32_t *slot, uint32_t *start, uint32_t bucket_ms, uint32_t now)
+{
+    int32_t elapsed = now - *start; // Wrap safe, a sample is never 24 days late.
+
+    if (elapsed < (int32_t)bucket_ms)
+    {
+        return;
+    }
+
+    uint32_t steps = (uint32_t)elapsed / bucket_ms;
+
+    if (steps >= length) // Everything is older than the ring.
+    {
+        memset(buckets, 0, sizeof(AirQualityBucket) * length);
+    }
+    else
+    {
+        for (uint32_t i = 1; i <= steps; i++)
+        {
+            memset(&buckets[(*slot + i) % length], 0, sizeof(AirQualityBucket));
+        }
+    }
+
+    *slot += steps;
+    *start += steps * bucket_ms;
+}
+
+// average returns the average of a channel over all buckets of a ring.
+float SPS30_air_quality::average(AirQualityBucket *buckets, uint8_t length, uint8_t channel, uint32_t *count)
+{
+    float sum = 0;
+    uint32_t samples = 0;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        sum += buckets[i].sum[channel];
+        samples += buckets[i].count;
+    }
+
+    if (count != NULL)
+    {
+        *count = samples;
+    }
+
+    return samples ? sum / samples : 0;
+}
@@ -0,0 +1,103 @@
+/**
+ * SPS30 - Air quality Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Derives air quality metrics from the measurements on the device:
+ * rolling 1 hour and 24 hour averages in bucketed aggregates, the US
+ * EPA AQI, the EU CAQI, the PM2.5/PM10 ratio, the particle size trend
+ * and dust events.
+ *********************************************************************
+*/
+
+#ifndef SPS30_AQI_H
+#define SPS30_AQI_H
+
+#include "sps30.h"
+
+#define AQ_HOUR_BUCKETS 12 // The hour is kept in buckets of 5 minutes
+#define AQ_DAY_BUCKETS 24  // The day is kept in buckets of 1 hour
+
+#define AQ_HOUR_BUCKET_MS (3600000UL / AQ_HOUR_BUCKETS)
+#define AQ_DAY_BUCKET_MS (86400000UL / AQ_DAY_BUCKETS)
+
+#define AQ_SPIKE_FACTOR 2.0      // A dust event starts above this factor times the baseline...
+#define AQ_SPIKE_OFFSET 5.0      // ...plus this offset in [μg/m3]
+#define AQ_BASELINE_SAMPLES 600  // Samples the day needs before it is used as the baseline
+
+enum aq_channels
+{
+    AQ_PM2,  // Mass concentration PM2.5
+    AQ_PM10, // Mass concentration PM10
+    AQ_SIZE, // Typical particle size
+    AQ_CHANNELS
+};
+
+enum aq_periods
+{
+    AQ_HOUR,
+    AQ_DAY
+};
+
+enum aq_events
+{
+    AQ_EVENT_NONE,  // Nothing changed
+    AQ_EVENT_START, // A dust event started with this sample
+    AQ_EVENT_END    // The dust event ended with this sample
+};
+
+// The bucket struct aggregates all samples of a time slot.
+struct AirQualityBucket
+{
+    float sum[AQ_CHANNELS];
+    uint16_t count;
+};
+
+// The dust event struct describes the current or last spike above the baseline.
+struct DustEvent
+{
+    uint32_t start;  // Time of the first sample above the threshold
+    uint32_t end;    // Time of the first sample below the threshold, 0 while active
+    float peak;      // Highest PM2.5 mass concentration [μg/m3]
+    float baseline;  // PM2.5 baseline when the event started [μg/m3]
+    boolean active;
+};
+
+class SPS30_air_quality
+{
+public:
+    SPS30_air_quality();
+
+    uint8_t add(const Measurements *v, uint32_t now = millis());
+    void clear();
+
+    float get_average(uint8_t channel, uint8_t period);
+    uint16_t get_us_aqi();
+    uint8_t get_caqi();
+    float get_pm_ratio();
+    float get_size_trend();
+    boolean get_event(DustEvent *event);
+
+private:
+    AirQualityBucket _hour[AQ_HOUR_BUCKETS];
+    AirQualityBucket _day[AQ_DAY_BUCKETS];
+    uint32_t _hour_slot;  // Slot number of the newest hour bucket, counted from the first sample
+    uint32_t _day_slot;   // Slot number of the newest day bucket
+    uint32_t _hour_start; // Time the newest hour bucket started
+    uint32_t _day_start;  // Time the newest day bucket started
+    boolean _empty;       // No sample has been added yet
+
+    DustEvent _event;
+    boolean _has_event = false;
+
+    void advance(AirQualityBucket *buckets, uint8_t length, uint32_t *slot, uint32_t *start, uint32_t bucket_ms, uint32_t now);
+    float average(AirQualityBucket *buckets, uint8_t length, uint8_t channel, uint32_t *count = NULL);
+};
+#endif
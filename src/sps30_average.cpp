@@ -0,0 +1,223 @@
+/**
+ * SPS30 - Averaging Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_average.h"
+
+#define MAD_SCALE 1.4826 // Scales the median absolute deviation to a standard deviation
+
+// Constructor, the sensor is only needed when get_values is used.
+SPS30_average::SPS30_average(SPS30 *sensor)
+{
+    _sensor = sensor;
+    clear();
+}
+
+// set_filter selects the outlier filter, the window can't be larger than AVERAGE_WINDOW.
+boolean SPS30_average::set_filter(uint8_t filter, uint8_t window, float threshold)
+{
+    if (filter > FILTER_HAMPEL || window == 0 || window > AVERAGE_WINDOW)
+    {
+        return false;
+    }
+
+    _filter = filter;
+    _window = window;
+    _threshold = threshold;
+    clear();
+
+    return true;
+}
+
+// get_values reads the given amount of new measurements and returns their filtered average.
+// Every sample is read only after the sensor reports new data, so no measurement is counted twice.
+SPS30_status SPS30_average::get_values(Measurements *v, uint8_t samples, float *confidence)
+{
+    if (_sensor == NULL || samples == 0)
+    {
+        return SPS30_status(SPS30_ERROR_PARAMETER);
+    }
+
+    // Without a running measurement there never is new data, start it like SPS30::get_values does.
+    if (!_sensor->is_started())
+    {
+        SPS30_status status = _sensor->start();
+
+        if (!status)
+        {
+            return status;
+        }
+    }
+
+    clear();
+
+    while (_count < samples)
+    {
+        uint32_t start_time = millis();
+
+        for (;;) // Wait for a new measurement.
+        {
+            SPS30_value<boolean> ready = _sensor->read_data_ready();
+
+            if (!ready.ok())
+            {
+                return ready;
+            }
+
+            if (ready.value)
+            {
+                break;
+            }
+
+            if (millis() - start_time > AVERAGE_TIME_OUT)
+            {
+                return SPS30_status(SPS30_ERROR_TIMEOUT);
+            }
+
+            delay(AVERAGE_POLL_MS);
+        }
+
+        Measurements sample;
+        SPS30_status status = _sensor->get_values(&sample);
+
+        if (!status)
+        {
+            return status;
+        }
+
+        add(&sample);
+    }
+
+    result(v, confidence);
+
+    return SPS30_status();
+}
+
+// clear forgets all samples.
+void SPS30_average::clear()
+{
+    memset(_sum, 0, sizeof(_sum));
+    _head = 0;
+    _filled = 0;
+    _count = 0;
+    _accepted = 0;
+}
+
+// add filters a measurement and adds it to the average, it returns false if any channel was an outlier.
+boolean SPS30_average::add(const Measurements *v)
+{
+    const float *values = &v->MassPM1;
+    uint8_t length = _filled < _window ? _filled + 1 : _window; // Samples in the window including this one.
+    boolean accepted = true;
+
+    for (uint8_t c = 0; c < AVERAGE_CHANNELS; c++)
+    {
+        float value = values[c];
+        _history[c][_head] = value;
+
+        if (_filter != FILTER_NONE && length >= 3) // Filtering needs a few samples to have a meaning.
+        {
+            float m = median(_history[c], length);
+
+            float deviation[AVERAGE_WINDOW];
+            for (uint8_t i = 0; i < length; i++)
+            {
+                deviation[i] = fabs(_history[c][i] - m);
+            }
+
+            // After a run of identical samples the MAD is 0, without a floor every later change would be an outlier.
+            float spread = MAD_SCALE * median(deviation, length);
+            float minimum = AVERAGE_SPREAD_MIN + AVERAGE_SPREAD_RELATIVE * fabs(m);
+            float limit = _threshold * (spread > minimum ? spread : minimum);
+
+            if (fabs(value - m) > limit)
+            {
+                accepted = false;
+
+                if (_filter == FILTER_HAMPEL)
+                {
+                    value = m; // Replace the outlier by the median.
+                }
+            }
+            else
+            {
+                _accepted++;
+            }
+
+            if (_filter == FILTER_MEDIAN)
+            {
+                value = m;
+            }
+        }
+        else
+        {
+            _accepted++;
+        }
+
+        _sum[c] += value;
+    }
+
+    _head = (_head + 1) % _window;
+
+    if (_filled < _window)
+    {
+        _filled++;
+    }
+
+    _count++;
+
+    return accepted;
+}
+
+// result returns the average of the samples added so far.
+// The confidence is the fraction of channel values that passed the outlier filter.
+void SPS30_average::result(Measurements *v, float *confidence)
+{
+    float *values = &v->MassPM1;
+
+    for (uint8_t c = 0; c < AVERAGE_CHANNELS; c++)
+    {
+        values[c] = _count ? _sum[c] / _count : 0;
+    }
+
+    if (confidence != NULL)
+    {
+        *confidence = _count ? (float)_accepted / ((float)_count * AVERAGE_CHANNELS) : 0;
+    }
+}
+
+// median returns the median of the values without changing their order.
+float SPS30_average::median(float *values, uint8_t length)
+{
+    float sorted[AVERAGE_WINDOW];
+
+    for (uint8_t i = 0; i < length; i++) // Insertion sort, the window is small.
+    {
+        float value = values[i];
+        uint8_t j = i;
+
+        while (j > 0 && sorted[j - 1] > value)
+        {
+            sorted[j] = sorted[j - 1];
+            j--;
+        }
+
+        sorted[j] = value;
+    }
+
+    if (length & 0x01)
+    {
+        return sorted[length / 2];
+    }
+
+    return (sorted[length / 2 - 1] + sorted[length / 2]) / 2;
+}
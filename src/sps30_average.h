@@ -0,0 +1,68 @@
+/**
+ * SPS30 - Averaging Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Averages N consecutive measurements per channel with an optional
+ * median or Hampel outlier filter, in constant memory.
+ *********************************************************************
+*/
+
+#ifndef SPS30_AVERAGE_H
+#define SPS30_AVERAGE_H
+
+#include "sps30.h"
+
+#define AVERAGE_CHANNELS 10          // Number of floats in a Measurements struct
+#define AVERAGE_WINDOW 5             // Max samples per channel kept for the outlier filter
+#define AVERAGE_THRESHOLD 3.0        // Default Hampel threshold in scaled MAD's
+#define AVERAGE_SPREAD_MIN 0.1       // The scaled MAD is at least this, in the unit of the channel
+#define AVERAGE_SPREAD_RELATIVE 0.05 // and at least this fraction of the median
+#define AVERAGE_POLL_MS 100          // Wait between two data ready checks
+#define AVERAGE_TIME_OUT 3000        // Give up when no new values arrive within this time
+
+enum filters
+{
+    FILTER_NONE,   // Plain mean of the raw samples
+    FILTER_MEDIAN, // Mean of the running median of the last window samples
+    FILTER_HAMPEL  // Samples further than threshold * MAD from the running median are replaced by it
+};
+
+class SPS30_average
+{
+public:
+    SPS30_average(SPS30 *sensor = NULL);
+
+    boolean set_filter(uint8_t filter, uint8_t window = AVERAGE_WINDOW, float threshold = AVERAGE_THRESHOLD);
+
+    SPS30_status get_values(Measurements *v, uint8_t samples, float *confidence = NULL);
+
+    void clear();
+    boolean add(const Measurements *v);
+    void result(Measurements *v, float *confidence = NULL);
+    uint32_t count() { return _count; }
+
+private:
+    SPS30 *_sensor;
+
+    uint8_t _filter = FILTER_NONE;
+    uint8_t _window = AVERAGE_WINDOW;
+    float _threshold = AVERAGE_THRESHOLD;
+
+    float _history[AVERAGE_CHANNELS][AVERAGE_WINDOW]; // Ring buffer with the last samples per channel
+    float _sum[AVERAGE_CHANNELS];                    // Sum of the filtered samples per channel
+    uint8_t _head = 0;                               // Next position in the ring buffers
+    uint8_t _filled = 0;                             // Samples in the ring buffers
+    uint32_t _count = 0;                             // Samples added since the last clear
+    uint32_t _accepted = 0;                          // Channel values that passed the filter
+
+    float median(float *values, uint8_t length);
+};
+#endif
@@ -0,0 +1,125 @@
+/**
+ * SPS30 - Change detection Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_change.h"
+
+// Constructor, without deadbands every change is reported.
+SPS30_change::SPS30_change(change_callback callback, void *context)
+{
+    _callback = callback;
+    _context = context;
+
+    memset(_absolute, 0, sizeof(_absolute));
+    memset(_relative, 0, sizeof(_relative));
+    memset(_rate, 0, sizeof(_rate));
+
+    clear();
+}
+
+// set_deadband sets the band around the last reported value of a channel (MassPM1 ... PartSize) in which changes are ignored.
+// The band is the largest of the absolute value and the relative fraction of the reported value.
+boolean SPS30_change::set_deadband(uint8_t value, float absolute, float relative)
+{
+    if (value < MassPM1 || value > PartSize)
+    {
+        return false;
+    }
+
+    _absolute[value - MassPM1] = absolute;
+    _relative[value - MassPM1] = relative;
+    return true;
+}
+
+// set_rate sets the change per second of a channel above which a measurement is reported right away.
+boolean SPS30_change::set_rate(uint8_t value, float rate)
+{
+    if (value < MassPM1 || value > PartSize)
+    {
+        return false;
+    }
+
+    _rate[value - MassPM1] = rate;
+    return true;
+}
+
+// clear forgets the reported measurement and the counters, the next measurement is reported.
+void SPS30_change::clear()
+{
+    _first = true;
+    _samples = 0;
+    _reports = 0;
+}
+
+// update evaluates a measurement and calls the callback when it has to be reported, it returns the reasons.
+uint8_t SPS30_change::update(const Measurements *v, uint32_t now)
+{
+    const float *values = &v->MassPM1;
+    const float *reported = &_reported.MassPM1;
+    const float *previous = &_previous.MassPM1;
+    uint8_t reasons = CHANGE_NONE;
+
+    _samples++;
+
+    if (_first)
+    {
+        reasons = CHANGE_FIRST;
+    }
+    else
+    {
+        float elapsed = (now - _previous_time) / 1000.0;
+
+        for (uint8_t c = 0; c < CHANGE_CHANNELS; c++)
+        {
+            float band = fabs(reported[c]) * _relative[c];
+            if (band < _absolute[c])
+            {
+                band = _absolute[c];
+            }
+
+            if (fabs(values[c] - reported[c]) > band)
+            {
+                reasons |= CHANGE_DEADBAND;
+            }
+
+            if (_rate[c] > 0 && elapsed > 0 && fabs(values[c] - previous[c]) > _rate[c] * elapsed)
+            {
+                reasons |= CHANGE_RATE;
+            }
+        }
+
+        if (_max_silence != 0 && now - _report_time >= _max_silence)
+        {
+            reasons |= CHANGE_HEARTBEAT;
+        }
+    }
+
+    _previous = *v;
+    _previous_time = now;
+
+    if (reasons == CHANGE_NONE)
+    {
+        return reasons;
+    }
+
+    _reported = *v;
+    _report_time = now;
+    _first = false;
+    _reports++;
+
+    if (_callback != NULL)
+    {
+        _callback(v, reasons, _context);
+    }
+
+    return reasons;
+}
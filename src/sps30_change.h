@@ -0,0 +1,72 @@
+/**
+ * SPS30 - Change detection Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Reports a measurement only when it differs enough from the last
+ * reported one, changes too fast, or nothing was reported for too long.
+ * A channel without a deadband is reported on every change, so give
+ * every channel that matters a band.
+ *********************************************************************
+*/
+
+#ifndef SPS30_CHANGE_H
+#define SPS30_CHANGE_H
+
+#include "sps30.h"
+
+#define CHANGE_CHANNELS 10 // Number of floats in a Measurements struct
+
+// Reasons a measurement is reported, more than one can be set.
+enum change_reasons
+{
+    CHANGE_NONE = 0x00,
+    CHANGE_FIRST = 0x01,    // The first measurement
+    CHANGE_DEADBAND = 0x02, // A channel left its deadband around the last reported value
+    CHANGE_RATE = 0x04,     // A channel changed faster than its rate limit since the previous sample
+    CHANGE_HEARTBEAT = 0x08 // Nothing was reported for the max silence
+};
+
+typedef void (*change_callback)(const Measurements *v, uint8_t reasons, void *context);
+
+class SPS30_change
+{
+public:
+    SPS30_change(change_callback callback = NULL, void *context = NULL);
+
+    boolean set_deadband(uint8_t value, float absolute, float relative = 0);
+    boolean set_rate(uint8_t value, float rate);
+    void set_heartbeat(uint32_t max_silence) { _max_silence = max_silence; }
+
+    uint8_t update(const Measurements *v, uint32_t now = millis());
+    void clear();
+
+    uint32_t get_sample_count() { return _samples; }
+    uint32_t get_report_count() { return _reports; }
+
+private:
+    change_callback _callback;
+    void *_context;
+
+    float _absolute[CHANGE_CHANNELS]; // Absolute deadband per channel
+    float _relative[CHANGE_CHANNELS]; // Deadband per channel relative to the reported value
+    float _rate[CHANGE_CHANNELS];     // Max change per second per channel, 0 disables it
+    uint32_t _max_silence = 0;        // Max ms between two reports, 0 disables the heartbeat
+
+    Measurements _reported;   // Last reported measurement
+    Measurements _previous;   // Previous measurement
+    uint32_t _report_time;    // Time of the last report
+    uint32_t _previous_time;  // Time of the previous measurement
+    boolean _first;           // Nothing has been reported yet
+
+    uint32_t _samples;
+    uint32_t _reports;
+};
+#endif
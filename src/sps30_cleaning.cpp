@@ -0,0 +1,113 @@
+/**
+ * SPS30 - Fan cleaning Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_cleaning.h"
+
+#define MAX_INTERVAL_S 4294967 // Longest interval in seconds that still fits in ms
+
+SPS30_cleaning::SPS30_cleaning(SPS30 *sensor)
+{
+    _sensor = sensor;
+}
+
+// begin sets the schedule, intervals are given in seconds.
+// The auto cleaning of the sensor itself is disabled, so no cleaning can happen outside a tracked window.
+SPS30_status SPS30_cleaning::begin(uint32_t interval, float quiet_level, uint32_t max_delay, uint32_t now)
+{
+    if (interval == 0 || interval > MAX_INTERVAL_S || max_delay > MAX_INTERVAL_S - interval)
+    {
+        return SPS30_status(SPS30_ERROR_PARAMETER);
+    }
+
+    _interval = interval * 1000;
+    _max_delay = max_delay * 1000;
+    _quiet_level = quiet_level;
+
+    _last_cleaning = now; // The first cleaning is due one interval from now.
+    _masking = false;
+
+    return _sensor->set_auto_clean_interval(0);
+}
+
+// update checks whether a sample was taken during a cleaning window and starts a cleaning when one is due.
+// A due cleaning waits for a quiet sample, unless it has been postponed for longer than the max delay.
+uint8_t SPS30_cleaning::update(const Measurements *v, uint32_t now)
+{
+    if (cleaning(now))
+    {
+        return SAMPLE_CLEANING;
+    }
+
+    uint32_t elapsed = now - _last_cleaning;
+
+    if (elapsed >= _interval)
+    {
+        if (v->MassPM10 <= _quiet_level || elapsed - _interval >= _max_delay)
+        {
+            clean(now); // On failure the next sample tries again.
+        }
+    }
+
+    return SAMPLE_VALID; // This sample was taken before the cleaning started.
+}
+
+// get_values reads the sensor values, during a cleaning window the bus isn't used and the values are suppressed.
+SPS30_status SPS30_cleaning::get_values(Measurements *v, uint32_t now)
+{
+    if (cleaning(now))
+    {
+        return SPS30_status(SPS30_ERROR_CLEANING);
+    }
+
+    SPS30_status status = _sensor->get_values(v);
+
+    if (status)
+    {
+        update(v, now);
+    }
+
+    return status;
+}
+
+// clean starts a fan cleaning right away and opens the cleaning window.
+SPS30_status SPS30_cleaning::clean(uint32_t now)
+{
+    SPS30_status status = _sensor->clean();
+
+    if (status)
+    {
+        _last_cleaning = now;
+        _masking = true;
+    }
+
+    return status;
+}
+
+// cleaning returns whether the fan is being cleaned or the values are still settling.
+boolean SPS30_cleaning::cleaning(uint32_t now)
+{
+    if (_masking && now - _last_cleaning >= CLEANING_DURATION_MS + CLEANING_SETTLE_MS)
+    {
+        _masking = false;
+    }
+
+    return _masking;
+}
+
+// time_to_cleaning returns the ms until the next cleaning is due, 0 when it is waiting for a quiet moment.
+uint32_t SPS30_cleaning::time_to_cleaning(uint32_t now)
+{
+    uint32_t elapsed = now - _last_cleaning;
+
+    return elapsed >= _interval ? 0 : _interval - elapsed;
+}
@@ -0,0 +1,60 @@
+/**
+ * SPS30 - Fan cleaning Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Schedules the fan cleaning at quiet moments and masks the samples
+ * taken while the fan is cleaned, without blocking.
+ *********************************************************************
+*/
+
+#ifndef SPS30_CLEANING_H
+#define SPS30_CLEANING_H
+
+#include "sps30.h"
+
+#define CLEANING_DURATION_MS 10000  // The fan runs at maximum speed for 10 seconds
+#define CLEANING_SETTLE_MS 5000     // Time the values need to settle after the cleaning
+#define CLEANING_INTERVAL_S 604800  // Default interval of a week, like the sensor's auto cleaning
+#define CLEANING_QUIET_LEVEL 10.0   // PM10 mass concentration [μg/m3] below which a cleaning has little impact
+#define CLEANING_MAX_DELAY_S 86400  // Clean anyway when no quiet moment was found within a day
+
+enum sample_flags
+{
+    SAMPLE_VALID,   // The sample can be used
+    SAMPLE_CLEANING // The sample was taken during or just after a fan cleaning
+};
+
+class SPS30_cleaning
+{
+public:
+    SPS30_cleaning(SPS30 *sensor);
+
+    SPS30_status begin(uint32_t interval = CLEANING_INTERVAL_S, float quiet_level = CLEANING_QUIET_LEVEL,
+                       uint32_t max_delay = CLEANING_MAX_DELAY_S, uint32_t now = millis());
+
+    uint8_t update(const Measurements *v, uint32_t now = millis());
+    SPS30_status get_values(Measurements *v, uint32_t now = millis());
+
+    SPS30_status clean(uint32_t now = millis());
+    boolean cleaning(uint32_t now = millis());
+    uint32_t time_to_cleaning(uint32_t now = millis());
+
+private:
+    SPS30 *_sensor;
+
+    uint32_t _interval = (uint32_t)CLEANING_INTERVAL_S * 1000; // Cleaning interval in ms
+    uint32_t _max_delay = (uint32_t)CLEANING_MAX_DELAY_S * 1000; // Max wait for a quiet moment in ms
+    float _quiet_level = CLEANING_QUIET_LEVEL;
+
+    uint32_t _last_cleaning = 0;  // Start of the last cleaning
+    boolean _masking = false;     // The last cleaning window hasn't been passed yet
+};
+#endif
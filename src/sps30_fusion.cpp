@@ -0,0 +1,260 @@
+/**
+ * SPS30 - Sensor fusion Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_fusion.h"
+
+#define HARDWARE_FAULTS (FUSION_SPEED | FUSION_LASER | FUSION_FAN)
+#define EXCLUDING_FAULTS (FUSION_LASER | FUSION_FAN) // A fan speed warning doesn't make the values wrong
+
+SPS30_fusion::SPS30_fusion()
+{
+    memset(_faults, 0, sizeof(_faults));
+    memset(_deviations, 0, sizeof(_deviations));
+}
+
+// add_sensor adds a started sensor, it returns false when FUSION_MAX_SENSORS are in use.
+boolean SPS30_fusion::add_sensor(SPS30 *sensor)
+{
+    if (_count >= FUSION_MAX_SENSORS)
+    {
+        return false;
+    }
+
+    _faults[_count] = FUSION_OK;
+    _deviations[_count] = 0;
+    _sensors[_count++] = sensor;
+
+    return true;
+}
+
+// set_method selects how the healthy units are combined, the trimmed mean drops trim values at both ends.
+void SPS30_fusion::set_method(uint8_t method, uint8_t trim)
+{
+    _method = method;
+    _trim = trim;
+}
+
+// set_tolerance sets how far a unit may be from the combined mass concentrations and for how many cycles.
+void SPS30_fusion::set_tolerance(float absolute, float relative, uint8_t cycles)
+{
+    _absolute = absolute;
+    _relative = relative;
+    _cycles = cycles ? cycles : 1;
+}
+
+// get_values reads all units and combines the units without communication, laser or fan faults.
+// A drifting unit or one with a fan speed warning is still used, the median and trimmed mean keep a single outlier out of the result.
+// When no unit can be used it returns SPS30_ERROR_NO_SENSOR if a unit was excluded for a fault, else the last read error.
+SPS30_status SPS30_fusion::get_values(Measurements *v)
+{
+    uint8_t units[FUSION_MAX_SENSORS];
+    uint8_t length = 0;
+    SPS30_status status(_count == 0 ? SPS30_ERROR_PARAMETER : SPS30_ERROR_NO_SENSOR); // Returned when no unit could be used.
+    boolean excluded = false;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        SPS30_status read = _sensors[i]->get_values(&_samples[i]);
+
+        if (!read)
+        {
+            _faults[i] |= FUSION_COMMS;
+            if (!excluded)
+            {
+                status = read;
+            }
+            continue;
+        }
+
+        _faults[i] &= ~FUSION_COMMS;
+
+        DeviceHealth health;
+        if (_sensors[i]->get_device_health(&health)) // A snapshot piggybacked on the measurement.
+        {
+            update_health(i, &health);
+        }
+
+        if ((_faults[i] & EXCLUDING_FAULTS) == 0)
+        {
+            units[length++] = i;
+        }
+        else
+        {
+            excluded = true;
+            status = SPS30_status(SPS30_ERROR_NO_SENSOR);
+        }
+    }
+
+    if (length == 0)
+    {
+        return status;
+    }
+
+    float *values = &v->MassPM1;
+    float channel[FUSION_MAX_SENSORS];
+
+    for (uint8_t c = 0; c < FUSION_CHANNELS; c++)
+    {
+        for (uint8_t i = 0; i < length; i++)
+        {
+            channel[i] = (&_samples[units[i]].MassPM1)[c];
+        }
+
+        values[c] = combine(channel, length);
+    }
+
+    check_drift(v, units, length);
+
+    return SPS30_status();
+}
+
+// check_status reads the status register of every unit, it is meant to be called rarely, or use set_health_ratio on the units.
+// It returns the last error, the units that could be read are updated anyway.
+SPS30_status SPS30_fusion::check_status()
+{
+    SPS30_status result;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        DeviceHealth health;
+        SPS30_status status = _sensors[i]->read_device_health(&health);
+
+        if (!status)
+        {
+            _faults[i] |= FUSION_COMMS;
+            result = status;
+            continue;
+        }
+
+        update_health(i, &health);
+    }
+
+    return result;
+}
+
+// get_suspects returns a bit per unit that has any fault.
+uint16_t SPS30_fusion::get_suspects()
+{
+    uint16_t suspects = 0;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_faults[i] != FUSION_OK)
+        {
+            suspects |= 1U << i;
+        }
+    }
+
+    return suspects;
+}
+
+// get_healthy_count returns the number of units without any fault.
+uint8_t SPS30_fusion::get_healthy_count()
+{
+    uint8_t healthy = 0;
+
+    for (uint8_t i = 0; i < _count; i++)
+    {
+        if (_faults[i] == FUSION_OK)
+        {
+            healthy++;
+        }
+    }
+
+    return healthy;
+}
+
+// update_health sets the hardware faults of a unit from its status register snapshot.
+void SPS30_fusion::update_health(uint8_t unit, const DeviceHealth *health)
+{
+    _faults[unit] &= ~HARDWARE_FAULTS;
+    _faults[unit] |= (health->speed ? FUSION_SPEED : 0) | (health->laser ? FUSION_LASER : 0) | (health->fan ? FUSION_FAN : 0);
+}
+
+// combine returns the median or trimmed mean, the values are sorted in place.
+float SPS30_fusion::combine(float *values, uint8_t length)
+{
+    for (uint8_t i = 1; i < length; i++) // Insertion sort, there are at most FUSION_MAX_SENSORS values.
+    {
+        float value = values[i];
+        uint8_t j = i;
+
+        while (j > 0 && values[j - 1] > value)
+        {
+            values[j] = values[j - 1];
+            j--;
+        }
+
+        values[j] = value;
+    }
+
+    if (_method == FUSION_TRIMMED_MEAN && length > 2 * _trim)
+    {
+        float sum = 0;
+
+        for (uint8_t i = _trim; i < length - _trim; i++)
+        {
+            sum += values[i];
+        }
+
+        return sum / (length - 2 * _trim);
+    }
+
+    if (length & 0x01)
+    {
+        return values[length / 2];
+    }
+
+    return (values[length / 2 - 1] + values[length / 2]) / 2;
+}
+
+// check_drift compares the mass concentrations of every unit with the combined values.
+// With only two units a difference can't be attributed, so both are marked when they disagree.
+void SPS30_fusion::check_drift(const Measurements *v, const uint8_t *units, uint8_t length)
+{
+    const float *combined = &v->MassPM1;
+
+    for (uint8_t i = 0; i < length; i++)
+    {
+        uint8_t unit = units[i];
+        const float *values = &_samples[unit].MassPM1;
+        boolean deviates = false;
+
+        // The combined value of two units lies halfway, so they are compared with each other instead.
+        const float *reference = length == 2 ? &_samples[units[1 - i]].MassPM1 : combined;
+
+        for (uint8_t c = 0; c < FUSION_MASS_CHANNELS; c++)
+        {
+            float tolerance = fabs(combined[c]) * _relative;
+            if (tolerance < _absolute)
+            {
+                tolerance = _absolute;
+            }
+
+            if (fabs(values[c] - reference[c]) > tolerance)
+            {
+                deviates = true;
+            }
+        }
+
+        if (!deviates)
+        {
+            _deviations[unit] = 0;
+            _faults[unit] &= ~FUSION_DRIFT;
+        }
+        else if (_deviations[unit] < _cycles && ++_deviations[unit] >= _cycles)
+        {
+            _faults[unit] |= FUSION_DRIFT;
+        }
+    }
+}
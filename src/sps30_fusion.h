@@ -0,0 +1,84 @@
+/**
+ * SPS30 - Sensor fusion Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Combines the measurements of co-located SPS30's into one robust
+ * value per channel and finds the unit that fails or drifts away from
+ * its peers. All work per cycle is bounded by FUSION_MAX_SENSORS.
+ *********************************************************************
+*/
+
+#ifndef SPS30_FUSION_H
+#define SPS30_FUSION_H
+
+#include "sps30.h"
+
+#ifndef FUSION_MAX_SENSORS
+#define FUSION_MAX_SENSORS 16 // Every sensor costs about 50 bytes RAM
+#endif
+
+#define FUSION_CHANNELS 10        // Number of floats in a Measurements struct
+#define FUSION_MASS_CHANNELS 4    // The mass concentrations are compared for drift
+#define FUSION_TOLERANCE 3.0      // Default drift tolerance in [μg/m3]...
+#define FUSION_RELATIVE 0.25      // ...or relative to the combined value, whichever is larger
+#define FUSION_SUSPECT_CYCLES 5   // Consecutive cycles out of tolerance before a unit drifts
+
+enum fusion_methods
+{
+    FUSION_MEDIAN,      // Median of the healthy units
+    FUSION_TRIMMED_MEAN // Mean of the healthy units without the lowest and highest
+};
+
+// Faults of a unit, more than one can be set.
+enum fusion_faults
+{
+    FUSION_OK = 0x00,
+    FUSION_COMMS = 0x01, // The measurement could not be read
+    FUSION_DRIFT = 0x02, // Out of tolerance with its peers for FUSION_SUSPECT_CYCLES
+    FUSION_SPEED = 0x04, // Fan speed out of range according to the status register, only a warning
+    FUSION_LASER = 0x08, // Laser failure according to the status register
+    FUSION_FAN = 0x10    // Fan failure according to the status register
+};
+
+class SPS30_fusion
+{
+public:
+    SPS30_fusion();
+
+    boolean add_sensor(SPS30 *sensor);
+    void set_method(uint8_t method, uint8_t trim = 1);
+    void set_tolerance(float absolute, float relative = FUSION_RELATIVE, uint8_t cycles = FUSION_SUSPECT_CYCLES);
+
+    SPS30_status get_values(Measurements *v);
+    SPS30_status check_status();
+
+    uint8_t get_faults(uint8_t sensor) { return sensor < _count ? _faults[sensor] : (uint8_t)FUSION_OK; }
+    uint16_t get_suspects();
+    uint8_t get_healthy_count();
+
+private:
+    SPS30 *_sensors[FUSION_MAX_SENSORS];
+    Measurements _samples[FUSION_MAX_SENSORS]; // Last measurement per unit
+    uint8_t _faults[FUSION_MAX_SENSORS];
+    uint8_t _deviations[FUSION_MAX_SENSORS];  // Consecutive cycles out of tolerance
+    uint8_t _count = 0;
+
+    uint8_t _method = FUSION_MEDIAN;
+    uint8_t _trim = 1;
+    float _absolute = FUSION_TOLERANCE;
+    float _relative = FUSION_RELATIVE;
+    uint8_t _cycles = FUSION_SUSPECT_CYCLES;
+
+    float combine(float *values, uint8_t length);
+    void update_health(uint8_t unit, const DeviceHealth *health);
+    void check_drift(const Measurements *v, const uint8_t *units, uint8_t length);
+};
+#endif
@@ -0,0 +1,401 @@
+/**
+ * SPS30 - Sample log Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_log.h"
+
+#define ERASE_CHUNK 64 // Bytes written at a time when a file segment is erased
+
+// log_crc calculates the CRC-16/CCITT of a header or record, the CRC field itself is excluded.
+static uint16_t log_crc(const void *data, uint16_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+    uint16_t crc = 0xFFFF;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        crc ^= (uint16_t)bytes[i] << 8;
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x8000 ? (crc << 1) ^ 0x1021 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+// erased returns whether all bytes still read as erased flash.
+static boolean erased(const void *data, uint16_t length)
+{
+    const uint8_t *bytes = (const uint8_t *)data;
+
+    for (uint16_t i = 0; i < length; i++)
+    {
+        if (bytes[i] != 0xFF)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+#if defined(ESP32) || defined(__unix__)
+SPS30_file_device::SPS30_file_device(FILE *file, uint32_t segment_size, uint16_t segment_count)
+{
+    _file = file;
+    _segment_size = segment_size;
+    _segment_count = segment_count;
+}
+
+// read reads from the file, what lies beyond its end reads as erased.
+boolean SPS30_file_device::read(uint32_t address, void *data, uint16_t length)
+{
+    memset(data, 0xFF, length);
+
+    if (fseek(_file, address, SEEK_SET) != 0)
+    {
+        return false;
+    }
+
+    fread(data, 1, length, _file);
+    return true;
+}
+
+boolean SPS30_file_device::write(uint32_t address, const void *data, uint16_t length)
+{
+    if (fseek(_file, address, SEEK_SET) != 0 || fwrite(data, 1, length, _file) != length)
+    {
+        return false;
+    }
+
+    return fflush(_file) == 0;
+}
+
+boolean SPS30_file_device::erase(uint16_t segment)
+{
+    uint8_t chunk[ERASE_CHUNK];
+    memset(chunk, 0xFF, sizeof(chunk));
+
+    if (fseek(_file, (uint32_t)segment * _segment_size, SEEK_SET) != 0)
+    {
+        return false;
+    }
+
+    for (uint32_t done = 0; done < _segment_size; done += sizeof(chunk))
+    {
+        uint16_t length = _segment_size - done < sizeof(chunk) ? _segment_size - done : sizeof(chunk);
+
+        if (fwrite(chunk, 1, length, _file) != length)
+        {
+            return false;
+        }
+    }
+
+    return fflush(_file) == 0;
+}
+#endif
+
+// begin reads the segment headers into the index and finds the end of the log in the newest segment.
+// A record that was torn by a power loss fails its CRC and is skipped, its slot isn't reused.
+boolean SPS30_log::begin(SPS30_block_device *device)
+{
+    _device = device;
+    _count = device->segment_count();
+    _used = 0;
+    _head = 0;
+    _slot = 0;
+
+    uint32_t size = device->segment_size();
+    if (_count == 0 || _count > LOG_MAX_SEGMENTS || size < sizeof(LogSegmentHeader) + sizeof(LogRecord))
+    {
+        _device = NULL;
+        return false;
+    }
+
+    _records = (size - sizeof(LogSegmentHeader)) / sizeof(LogRecord);
+
+    for (uint16_t s = 0; s < _count; s++)
+    {
+        LogSegmentHeader header;
+
+        _segments[s].sequence = LOG_EMPTY;
+
+        if (!device->read(address(s, 0) - sizeof(header), &header, sizeof(header)))
+        {
+            return false;
+        }
+
+        if (header.magic != LOG_MAGIC || header.crc != log_crc(&header, offsetof(LogSegmentHeader, crc)))
+        {
+            continue; // Erased, or the header write was interrupted.
+        }
+
+        _segments[s].sequence = header.sequence;
+        _segments[s].first_record = header.first_record;
+        _segments[s].first_time = header.first_time;
+
+        if (_used == 0 || header.sequence > _segments[_head].sequence)
+        {
+            _head = s;
+            _used = 1;
+        }
+    }
+
+    if (_used == 0) // An empty log.
+    {
+        return true;
+    }
+
+    // The log is the run of consecutive segment numbers that ends at the head, anything else is stale.
+    // It stops at segment 0, below it the numbers would wrap around to the LOG_EMPTY of an erased segment.
+    while (_used < _count && _used <= _segments[_head].sequence)
+    {
+        uint32_t sequence = _segments[(ring(0) + _count - 1) % _count].sequence;
+
+        if (sequence == LOG_EMPTY || sequence != _segments[_head].sequence - _used)
+        {
+            break;
+        }
+
+        _used++;
+    }
+
+    for (uint16_t s = 0; s < _count; s++)
+    {
+        if ((uint16_t)(_head - s + _count) % _count >= _used)
+        {
+            _segments[s].sequence = LOG_EMPTY;
+        }
+    }
+
+    // Only the head segment is scanned, up to the first slot that was never written.
+    for (_slot = 0; _slot < _records; _slot++)
+    {
+        LogRecord record;
+
+        if (!device->read(address(_head, _slot), &record, sizeof(record)))
+        {
+            return false;
+        }
+
+        if (erased(&record, sizeof(record)))
+        {
+            break;
+        }
+    }
+
+    return true;
+}
+
+// append writes a measurement at the end of the log, when the storage is full the oldest segment is overwritten.
+boolean SPS30_log::append(const Measurements *v, uint32_t time)
+{
+    if (_device == NULL)
+    {
+        return false;
+    }
+
+    if ((_used == 0 || _slot >= _records) && !open_segment(time))
+    {
+        return false;
+    }
+
+    LogRecord record;
+    record.sequence = _segments[_head].first_record + _slot;
+    record.time = time;
+    record.values = *v;
+    record.crc = log_crc(&record, offsetof(LogRecord, crc));
+    record.reserved = 0xFFFF;
+
+    // A failed write may have programmed part of the slot, so it is never used again.
+    return _device->write(address(_head, _slot++), &record, sizeof(record));
+}
+
+// clear erases the whole log.
+boolean SPS30_log::clear()
+{
+    if (_device == NULL)
+    {
+        return false;
+    }
+
+    for (uint16_t s = 0; s < _count; s++)
+    {
+        _segments[s].sequence = LOG_EMPTY;
+
+        if (!_device->erase(s))
+        {
+            return false;
+        }
+    }
+
+    _used = 0;
+    _head = 0;
+    _slot = 0;
+
+    return true;
+}
+
+// oldest returns the position of the oldest record.
+uint32_t SPS30_log::oldest()
+{
+    return _used == 0 ? end() : (uint32_t)ring(0) * _records;
+}
+
+// end returns the position the next record will be written to.
+uint32_t SPS30_log::end()
+{
+    return (uint32_t)_head * _records + _slot;
+}
+
+// seek returns the position of the first record at or after the given time, end() if there is none.
+// The segment is found by a binary search over the index, only that segment is scanned.
+uint32_t SPS30_log::seek(uint32_t time)
+{
+    if (_used == 0 || _segments[ring(0)].first_time > time)
+    {
+        return oldest();
+    }
+
+    uint16_t low = 0;
+    uint16_t high = _used - 1;
+
+    while (low < high) // Find the last segment that starts at or before the time.
+    {
+        uint16_t middle = (low + high + 1) / 2;
+
+        if (_segments[ring(middle)].first_time <= time)
+        {
+            low = middle;
+        }
+        else
+        {
+            high = middle - 1;
+        }
+    }
+
+    uint32_t position = (uint32_t)ring(low) * _records;
+    LogRecord record;
+
+    for (;;)
+    {
+        uint32_t found = position;
+
+        if (!read(&position, &record))
+        {
+            return end();
+        }
+
+        if (record.time >= time)
+        {
+            return found;
+        }
+    }
+}
+
+// read returns the record at a position and moves the position to the next one, corrupt records are skipped.
+// It returns false when the end of the log is reached.
+boolean SPS30_log::read(uint32_t *position, LogRecord *record)
+{
+    if (_device == NULL)
+    {
+        return false;
+    }
+
+    while (*position != end())
+    {
+        uint16_t segment = *position / _records;
+        uint16_t slot = *position % _records;
+
+        if (segment >= _count || _segments[segment].sequence == LOG_EMPTY) // Overwritten since the position was taken.
+        {
+            uint32_t restart = oldest();
+
+            // Restarting has to get somewhere, or the index is broken and this would loop forever.
+            if (restart == *position || (restart != end() && _segments[restart / _records].sequence == LOG_EMPTY))
+            {
+                return false;
+            }
+
+            *position = restart;
+            continue;
+        }
+
+        // Go to the next segment after the last slot, but stay in the head so end() is reached.
+        if (slot + 1 < _records || segment == _head)
+        {
+            (*position)++;
+        }
+        else
+        {
+            *position = (uint32_t)((segment + 1) % _count) * _records;
+        }
+
+        if (_device->read(address(segment, slot), record, sizeof(LogRecord)) &&
+            record->crc == log_crc(record, offsetof(LogRecord, crc)) &&
+            record->sequence == _segments[segment].first_record + slot)
+        {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+// open_segment erases the segment after the head and writes its header, the oldest segment is dropped when all are in use.
+boolean SPS30_log::open_segment(uint32_t time)
+{
+    uint16_t segment = _used == 0 ? _head : (_head + 1) % _count;
+    LogSegmentHeader header;
+
+    header.magic = LOG_MAGIC;
+    header.sequence = _used == 0 ? 0 : _segments[_head].sequence + 1;
+    header.first_record = _used == 0 ? 0 : _segments[_head].first_record + _records;
+    header.first_time = time;
+    header.crc = log_crc(&header, offsetof(LogSegmentHeader, crc));
+    header.reserved = 0xFFFF;
+
+    if (_used == _count)
+    {
+        _used--;
+    }
+    _segments[segment].sequence = LOG_EMPTY;
+
+    if (!_device->erase(segment) || !_device->write(address(segment, 0) - sizeof(header), &header, sizeof(header)))
+    {
+        return false;
+    }
+
+    _segments[segment].sequence = header.sequence;
+    _segments[segment].first_record = header.first_record;
+    _segments[segment].first_time = header.first_time;
+
+    _head = segment;
+    _slot = 0;
+    _used++;
+
+    return true;
+}
+
+// ring returns the segment at an index in the log, 0 being the oldest.
+uint16_t SPS30_log::ring(uint16_t index)
+{
+    return (_head + _count + 1 - _used + index) % _count;
+}
+
+// address returns the storage address of a record slot.
+uint32_t SPS30_log::address(uint16_t segment, uint16_t slot)
+{
+    return (uint32_t)segment * _device->segment_size() + sizeof(LogSegmentHeader) + (uint32_t)slot * sizeof(LogRecord);
+}
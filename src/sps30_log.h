@@ -0,0 +1,127 @@
+/**
+ * SPS30 - Sample log Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Keeps measurements in an append-only log on flash, SD or a file.
+ * The storage is split into segments that are written round robin,
+ * every segment starts with a header and holds fixed size records
+ * with a sequence number and a CRC. A segment is only erased right
+ * before it is reused, so the wear is spread evenly.
+ *
+ * On begin only the segment headers are read, which gives a sparse
+ * index of the first time per segment, and only the newest segment
+ * is scanned to find the end of the log after a crash or power loss.
+ *********************************************************************
+*/
+
+#ifndef SPS30_LOG_H
+#define SPS30_LOG_H
+
+#include "sps30.h"
+
+#ifndef LOG_MAX_SEGMENTS
+#define LOG_MAX_SEGMENTS 16 // Max segments of a device, every segment costs 12 bytes RAM
+#endif
+
+#define LOG_MAGIC 0x53505330 // "SPS0"
+#define LOG_EMPTY 0xFFFFFFFF // Erased flash, the sequence of a free segment
+
+// The segment header struct is written once, with the first record of a segment.
+struct LogSegmentHeader
+{
+    uint32_t magic;
+    uint32_t sequence;     // Segment number, increases by one for every new segment
+    uint32_t first_record; // Sequence number of the first record
+    uint32_t first_time;   // Time of the first record
+    uint16_t crc;
+    uint16_t reserved;
+};
+
+// The record struct holds one measurement.
+struct LogRecord
+{
+    uint32_t sequence; // Increases by one for every record, also over segments
+    uint32_t time;     // Time given to append, should not decrease
+    Measurements values;
+    uint16_t crc;
+    uint16_t reserved;
+};
+
+// The segment struct is the RAM index of a segment.
+struct LogSegment
+{
+    uint32_t sequence; // LOG_EMPTY when the segment isn't part of the log
+    uint32_t first_record;
+    uint32_t first_time;
+};
+
+// The block device class is the storage backend, derive from it for SPIFFS, LittleFS, SD or raw flash.
+// Erased storage must read as 0xFF, a write only has to be able to program erased bytes.
+class SPS30_block_device
+{
+public:
+    virtual uint32_t segment_size() = 0;  // Bytes per segment, the erase unit
+    virtual uint16_t segment_count() = 0;
+    virtual boolean read(uint32_t address, void *data, uint16_t length) = 0;
+    virtual boolean write(uint32_t address, const void *data, uint16_t length) = 0;
+    virtual boolean erase(uint16_t segment) = 0;
+};
+
+#if defined(ESP32) || defined(__unix__)
+#include <stdio.h>
+
+// The file device keeps the log in a file opened with "r+b" or "w+b", on the ESP32 this works on a SPIFFS, LittleFS or SD mount.
+class SPS30_file_device : public SPS30_block_device
+{
+public:
+    SPS30_file_device(FILE *file, uint32_t segment_size, uint16_t segment_count);
+
+    uint32_t segment_size() { return _segment_size; }
+    uint16_t segment_count() { return _segment_count; }
+    boolean read(uint32_t address, void *data, uint16_t length);
+    boolean write(uint32_t address, const void *data, uint16_t length);
+    boolean erase(uint16_t segment);
+
+private:
+    FILE *_file;
+    uint32_t _segment_size;
+    uint16_t _segment_count;
+};
+#endif
+
+class SPS30_log
+{
+public:
+    boolean begin(SPS30_block_device *device);
+
+    boolean append(const Measurements *v, uint32_t time);
+    boolean clear();
+
+    // Records are read with a position, from oldest() or seek() up to end().
+    uint32_t oldest();
+    uint32_t end();
+    uint32_t seek(uint32_t time);
+    boolean read(uint32_t *position, LogRecord *record);
+
+private:
+    SPS30_block_device *_device = NULL;
+    LogSegment _segments[LOG_MAX_SEGMENTS]; // Sparse index with the first time per segment
+    uint16_t _count = 0;    // Segments of the device
+    uint16_t _records = 0;  // Records per segment
+    uint16_t _used = 0;     // Segments in the log, the newest is the head
+    uint16_t _head = 0;     // Segment that is written
+    uint16_t _slot = 0;     // Next record in the head segment
+
+    boolean open_segment(uint32_t time);
+    uint16_t ring(uint16_t index);
+    uint32_t address(uint16_t segment, uint16_t slot);
+};
+#endif
@@ -0,0 +1,227 @@
+/**
+ * SPS30 - Publisher Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_publisher.h"
+
+static_assert(PUBLISHER_MAX_SENSORS <= 8, "The subscriptions hold a bit per sensor");
+static_assert(PUBLISHER_MAX_CLIENTS <= 32767, "Client slots are returned as int16_t");
+
+SPS30_publisher::SPS30_publisher()
+{
+    memset(_clients, 0, sizeof(_clients));
+}
+
+// add_sensor adds a sensor and returns its number, -1 when PUBLISHER_MAX_SENSORS are in use.
+// Without a sensor, measurements are only published with publish, otherwise poll reads them.
+int8_t SPS30_publisher::add_sensor(SPS30 *sensor)
+{
+    if (_sensor_count >= PUBLISHER_MAX_SENSORS)
+    {
+        return -1;
+    }
+
+    _sensors[_sensor_count] = sensor;
+    _count[_sensor_count] = 0;
+
+    return _sensor_count++;
+}
+
+// add_client adds a client that gets the sensors of the mask, it returns the slot or -1 when all are in use.
+// A client that returns 0 from availableForWrite doesn't report its free space and gets every frame.
+int16_t SPS30_publisher::add_client(Print *client, uint8_t sensors)
+{
+    for (uint16_t i = 0; i < PUBLISHER_MAX_CLIENTS; i++)
+    {
+        if (_clients[i] == NULL)
+        {
+            _clients[i] = client;
+            _subscriptions[i] = sensors;
+            _pending[i] = 0;
+
+            for (uint8_t s = 0; s < _sensor_count; s++) // Start with the latest measurements.
+            {
+                if (_count[s] != 0)
+                {
+                    _pending[i] |= 1 << s;
+                }
+            }
+
+            _pending[i] &= sensors;
+            return i;
+        }
+    }
+
+    return -1;
+}
+
+void SPS30_publisher::remove_client(Print *client)
+{
+    for (uint16_t i = 0; i < PUBLISHER_MAX_CLIENTS; i++)
+    {
+        if (_clients[i] == client)
+        {
+            _clients[i] = NULL;
+        }
+    }
+}
+
+// publish replaces the latest measurement of a sensor and marks it for every subscribed client.
+void SPS30_publisher::publish(uint8_t sensor, const Measurements *v, uint32_t time)
+{
+    if (sensor >= _sensor_count)
+    {
+        return;
+    }
+
+    _latest[sensor] = *v;
+    _time[sensor] = time;
+    _count[sensor]++;
+
+    uint8_t bit = 1 << sensor;
+
+    for (uint16_t i = 0; i < PUBLISHER_MAX_CLIENTS; i++)
+    {
+        if (_clients[i] == NULL || (_subscriptions[i] & bit) == 0)
+        {
+            continue;
+        }
+
+        if (_pending[i] & bit)
+        {
+            _skipped++;
+        }
+
+        _pending[i] |= bit;
+    }
+}
+
+// poll reads all sensors once per measurement interval and publishes the values, it returns the last error.
+SPS30_status SPS30_publisher::poll(uint32_t now)
+{
+    SPS30_status result;
+
+    if (now - _read_time < MEASUREMENT_INTERVAL_MS)
+    {
+        return result;
+    }
+
+    _read_time = now;
+
+    for (uint8_t s = 0; s < _sensor_count; s++)
+    {
+        Measurements v;
+
+        if (_sensors[s] == NULL)
+        {
+            continue;
+        }
+
+        SPS30_status status = _sensors[s]->get_values(&v);
+
+        if (status)
+        {
+            publish(s, &v, now);
+        }
+        else
+        {
+            result = status;
+        }
+    }
+
+    return result;
+}
+
+// flush writes the pending frames to every client that has room for a whole frame, it never waits.
+// A client whose availableForWrite returns 0 doesn't know its room, it gets the frames regardless.
+void SPS30_publisher::flush()
+{
+    uint8_t frames[PUBLISHER_MAX_SENSORS][PUBLISHER_FRAME_LENGTH];
+    uint8_t built = 0; // Bit per sensor whose frame has been built
+
+    for (uint16_t i = 0; i < PUBLISHER_MAX_CLIENTS; i++)
+    {
+        if (_clients[i] == NULL || _pending[i] == 0)
+        {
+            continue;
+        }
+
+        for (uint8_t s = 0; s < _sensor_count; s++)
+        {
+            uint8_t bit = 1 << s;
+
+            if ((_pending[i] & bit) == 0)
+            {
+                continue;
+            }
+
+            int room = _clients[i]->availableForWrite();
+
+            if (room != 0 && room < PUBLISHER_FRAME_LENGTH)
+            {
+                break; // Try again with the next flush, by then the frame may have been replaced.
+            }
+
+            if ((built & bit) == 0) // Every frame is built once, for all clients.
+            {
+                build_frame(s, frames[s]);
+                built |= bit;
+            }
+
+            _clients[i]->write(frames[s], PUBLISHER_FRAME_LENGTH);
+            _pending[i] &= ~bit;
+            _sent++;
+        }
+    }
+}
+
+// build_frame builds the frame of the latest measurement of a sensor.
+void SPS30_publisher::build_frame(uint8_t sensor, uint8_t *frame)
+{
+    uint8_t i = 0;
+
+    frame[i++] = PUBLISHER_SYNC;
+    frame[i++] = sensor;
+    frame[i++] = _count[sensor] >> 8;
+    frame[i++] = _count[sensor];
+    frame[i++] = _time[sensor] >> 24;
+    frame[i++] = _time[sensor] >> 16;
+    frame[i++] = _time[sensor] >> 8;
+    frame[i++] = _time[sensor];
+
+    const float *values = &_latest[sensor].MassPM1;
+
+    for (uint8_t c = 0; c < 10; c++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &values[c], sizeof(bits));
+
+        frame[i++] = bits >> 24;
+        frame[i++] = bits >> 16;
+        frame[i++] = bits >> 8;
+        frame[i++] = bits;
+    }
+
+    uint8_t crc = I2C_CRC_INITIALIZATION;
+
+    for (uint8_t b = 0; b < i; b++)
+    {
+        crc ^= frame[b];
+
+        for (uint8_t bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ I2C_CRC_POLYNOMIAL : crc << 1;
+        }
+    }
+
+    frame[i] = crc;
+}
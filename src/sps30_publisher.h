@@ -0,0 +1,81 @@
+/**
+ * SPS30 - Publisher Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Streams the latest measurement of every sensor to many clients
+ * (WiFiClient, EthernetClient, Serial ...) from the sensor loop,
+ * without a task per client and without ever blocking on a client.
+ *
+ * A frame is only written when the client has room for all of it.
+ * A client that is too slow skips measurements and gets the latest
+ * one once it has room again. A client whose availableForWrite
+ * returns 0, like the base Print, doesn't report its room and gets
+ * every frame written right away.
+ *
+ * PUBLISHER_MAX_CLIENTS may be raised to hundreds of clients, up to
+ * 32767, every slot costs a pointer and two bytes of RAM.
+ *
+ * Frame, 49 bytes, multi byte values big endian like the sensor:
+ *   0xA5 | sensor | count (2) | time (4) | 10 floats (40) | CRC8
+ * The CRC8 is the sensor's I2C CRC (0x31) over all other bytes.
+ *********************************************************************
+*/
+
+#ifndef SPS30_PUBLISHER_H
+#define SPS30_PUBLISHER_H
+
+#include "sps30.h"
+
+#ifndef PUBLISHER_MAX_CLIENTS
+#define PUBLISHER_MAX_CLIENTS 8
+#endif
+
+#ifndef PUBLISHER_MAX_SENSORS
+#define PUBLISHER_MAX_SENSORS 4
+#endif
+
+#define PUBLISHER_SYNC 0xA5
+#define PUBLISHER_FRAME_LENGTH 49
+
+class SPS30_publisher
+{
+public:
+    SPS30_publisher();
+
+    int8_t add_sensor(SPS30 *sensor = NULL);
+    int16_t add_client(Print *client, uint8_t sensors = 0xFF);
+    void remove_client(Print *client);
+
+    void publish(uint8_t sensor, const Measurements *v, uint32_t time = millis());
+    SPS30_status poll(uint32_t now = millis());
+    void flush();
+
+    uint32_t get_sent_count() { return _sent; }
+    uint32_t get_skipped_count() { return _skipped; }
+
+private:
+    SPS30 *_sensors[PUBLISHER_MAX_SENSORS];
+    Measurements _latest[PUBLISHER_MAX_SENSORS]; // Latest measurement per sensor
+    uint32_t _time[PUBLISHER_MAX_SENSORS];
+    uint16_t _count[PUBLISHER_MAX_SENSORS];      // Measurements published per sensor
+    uint32_t _read_time = 0;                     // Time of the last poll
+    uint8_t _sensor_count = 0;
+
+    Print *_clients[PUBLISHER_MAX_CLIENTS];
+    uint8_t _subscriptions[PUBLISHER_MAX_CLIENTS]; // Bit per sensor the client wants
+    uint8_t _pending[PUBLISHER_MAX_CLIENTS];       // Bit per sensor with a measurement the client hasn't got
+
+    uint32_t _sent = 0;    // Frames written
+    uint32_t _skipped = 0; // Measurements replaced before a slow client got them
+
+    void build_frame(uint8_t sensor, uint8_t *frame);
+};
+#endif
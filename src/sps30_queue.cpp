@@ -0,0 +1,218 @@
+/**
+ * SPS30 - Command queue Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_queue.h"
+
+SPS30_queue::SPS30_queue(SPS30 *sensor)
+{
+    _sensor = sensor;
+    clear();
+}
+
+// clear drops the pending commands without calling back, forgets the shared values and resets the counters.
+void SPS30_queue::clear()
+{
+    _length = 0;
+    _valid = false;
+    _issued = 0;
+    _coalesced = 0;
+}
+
+// submit adds a command to the queue, it returns false when the queue is full or the command can't be queued.
+boolean SPS30_queue::submit(uint8_t command, queue_callback callback, void *ctx)
+{
+    if (_length >= QUEUE_LENGTH || !accepts(command))
+    {
+        return false;
+    }
+
+    QueueEntry *entry = &_queue[_length++];
+    entry->command = command;
+    entry->callback = callback;
+    entry->ctx = ctx;
+
+    return true;
+}
+
+// process runs the pending commands in the order of submission, it returns the number of bus transactions.
+// The reads before a stop, sleep or reset share one read before it, the other commands in between run first.
+uint8_t SPS30_queue::process(uint32_t now)
+{
+    uint32_t issued = _issued;
+    uint8_t length = _length;
+    QueueEntry batch[QUEUE_LENGTH];
+
+    // Take the commands from the queue first, commands submitted by the callbacks wait for the next call.
+    memcpy(batch, _queue, length * sizeof(QueueEntry));
+    _length = 0;
+
+    uint8_t first = 0; // First command since the last stop, sleep or reset
+
+    for (uint8_t i = 0; i <= length; i++)
+    {
+        if (i < length && !ends_measurement(batch[i].command))
+        {
+            if (batch[i].command != READ_MEASURED_VALUE)
+            {
+                run(&batch[i]);
+            }
+            continue;
+        }
+
+        read(&batch[first], i - first, now);
+
+        if (i < length)
+        {
+            run(&batch[i]);
+        }
+
+        first = i + 1;
+    }
+
+    return _issued - issued;
+}
+
+// run executes a command that isn't a read and calls back.
+void SPS30_queue::run(const QueueEntry *entry)
+{
+    SPS30_status status = execute(entry->command);
+
+    if (entry->callback != NULL)
+    {
+        entry->callback(entry->command, status, NULL, entry->ctx);
+    }
+}
+
+// read gives the reads among the commands one read and calls every one of them back with it.
+void SPS30_queue::read(const QueueEntry *entries, uint8_t count, uint32_t now)
+{
+    uint8_t reads = 0;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        reads += entries[i].command == READ_MEASURED_VALUE;
+    }
+
+    if (reads == 0)
+    {
+        return;
+    }
+
+    Measurements values;
+    SPS30_status status = get_values(&values, now);
+    _coalesced += reads - 1;
+
+    for (uint8_t i = 0; i < count; i++)
+    {
+        if (entries[i].command == READ_MEASURED_VALUE && entries[i].callback != NULL)
+        {
+            entries[i].callback(READ_MEASURED_VALUE, status, status ? &values : NULL, entries[i].ctx);
+        }
+    }
+}
+
+// get_values returns the values of the last read when it is less than a measurement interval old, else it reads new ones.
+SPS30_status SPS30_queue::get_values(Measurements *v, uint32_t now)
+{
+    if (_valid && now - _read_time < MEASUREMENT_INTERVAL_MS)
+    {
+        _coalesced++;
+        *v = _values;
+        return SPS30_status();
+    }
+
+    _issued++;
+    SPS30_status status = _sensor->get_values(&_values);
+
+    if (!status)
+    {
+        _valid = false;
+        return status;
+    }
+
+    _valid = true;
+    _read_time = now;
+    *v = _values;
+
+    return status;
+}
+
+// get_value returns a single value, like get_mass_PM2 on the sensor, from the shared values.
+SPS30_value<float> SPS30_queue::get_value(uint8_t value, uint32_t now)
+{
+    if (value < MassPM1 || value > PartSize)
+    {
+        return SPS30_value<float>(SPS30_status(SPS30_ERROR_PARAMETER));
+    }
+
+    Measurements v;
+    SPS30_status status = get_values(&v, now);
+
+    if (!status)
+    {
+        return SPS30_value<float>(status);
+    }
+
+    const float *values = &v.MassPM1; // The struct holds the values in the order of the enum.
+
+    return SPS30_value<float>(status, values[value - MassPM1]);
+}
+
+// execute sends a command that isn't a read. Any of them changes the state of the sensor, so the shared values are dropped.
+SPS30_status SPS30_queue::execute(uint8_t command)
+{
+    _issued++;
+    _valid = false;
+
+    switch (command)
+    {
+    case START_MEASUREMENT:
+        return _sensor->start();
+    case STOP_MEASUREMENT:
+        return _sensor->stop();
+    case SLEEP:
+        return _sensor->sleep();
+    case WAKE_UP:
+        return _sensor->wake_up();
+    case START_FAN_CLEANING:
+        return _sensor->clean();
+    case RESET:
+        return _sensor->reset();
+    }
+
+    return SPS30_status(SPS30_ERROR_PARAMETER);
+}
+
+// ends_measurement returns whether the sensor has no new values after a command, the reads before it go first.
+boolean SPS30_queue::ends_measurement(uint8_t command)
+{
+    return command == STOP_MEASUREMENT || command == SLEEP || command == RESET;
+}
+
+// accepts returns whether a command can be queued.
+boolean SPS30_queue::accepts(uint8_t command)
+{
+    switch (command)
+    {
+    case START_MEASUREMENT:
+    case STOP_MEASUREMENT:
+    case READ_MEASURED_VALUE:
+    case SLEEP:
+    case WAKE_UP:
+    case START_FAN_CLEANING:
+    case RESET:
+        return true;
+    }
+
+    return false;
+}
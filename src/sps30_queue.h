@@ -0,0 +1,82 @@
+/**
+ * SPS30 - Command queue Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A command queue per sensor for firmware where several modules use
+ * the same sensor, like a display, a logger and an uplink.
+ *
+ * The commands run in the order of submission. The reads submitted
+ * before a stop, sleep or reset are coalesced into one bus transaction
+ * just before it, after the start, wake up or cleaning commands among
+ * them, and the values are handed to every requester. Reads are rate
+ * limited to the measurement interval, within it the last values are
+ * shared.
+ *
+ * The modules submit commands with a callback and the loop calls
+ * process once. Or they call get_values or get_value directly, which
+ * share the values in the same way. Submit and process aren't locked,
+ * with an RTOS call them from one task.
+ *********************************************************************
+*/
+
+#ifndef SPS30_QUEUE_H
+#define SPS30_QUEUE_H
+
+#include "sps30.h"
+
+#define QUEUE_LENGTH 16 // Max pending commands
+
+// Called with the result of a command, the values are only given for a read and are NULL otherwise.
+typedef void (*queue_callback)(uint8_t command, SPS30_status status, const Measurements *v, void *ctx);
+
+struct QueueEntry
+{
+    uint8_t command; // START_MEASUREMENT, STOP_MEASUREMENT, READ_MEASURED_VALUE, SLEEP, WAKE_UP, START_FAN_CLEANING or RESET
+    queue_callback callback;
+    void *ctx;
+};
+
+class SPS30_queue
+{
+public:
+    SPS30_queue(SPS30 *sensor);
+
+    boolean submit(uint8_t command, queue_callback callback = NULL, void *ctx = NULL);
+    uint8_t process(uint32_t now = millis());
+    uint8_t pending() { return _length; }
+
+    SPS30_status get_values(Measurements *v, uint32_t now = millis());
+    SPS30_value<float> get_value(uint8_t value, uint32_t now = millis());
+
+    uint32_t get_issued_count() { return _issued; }
+    uint32_t get_coalesced_count() { return _coalesced; }
+    void clear();
+
+private:
+    SPS30 *_sensor;
+
+    QueueEntry _queue[QUEUE_LENGTH]; // Pending commands in the order of submission
+    uint8_t _length;
+
+    Measurements _values;  // The values of the last read, shared until the next measurement interval
+    uint32_t _read_time;   // Time of the last read
+    boolean _valid;        // The shared values can be used
+
+    uint32_t _issued;    // Bus transactions
+    uint32_t _coalesced; // Requests served without a transaction of their own
+
+    void run(const QueueEntry *entry);
+    void read(const QueueEntry *entries, uint8_t count, uint32_t now);
+    SPS30_status execute(uint8_t command);
+    boolean ends_measurement(uint8_t command);
+    boolean accepts(uint8_t command);
+};
+#endif
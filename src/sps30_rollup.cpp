@@ -0,0 +1,196 @@
+/**
+ * SPS30 - Rollup Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_rollup.h"
+
+// Bucket length and number of buckets per tier.
+static const uint32_t spans[ROLLUP_TIERS] = {1, 60, 3600};
+static const uint16_t lengths[ROLLUP_TIERS] = {ROLLUP_SECONDS, ROLLUP_MINUTES, ROLLUP_HOURS};
+
+SPS30_rollup::SPS30_rollup()
+{
+    clear();
+}
+
+// clear forgets the whole history.
+void SPS30_rollup::clear()
+{
+    memset(_second_time, 0xFF, sizeof(_second_time)); // No time a sample will have soon.
+    memset(_minutes, 0, sizeof(_minutes));
+    memset(_hours, 0, sizeof(_hours));
+    _newest = 0;
+    _empty = true;
+}
+
+// add adds a sample to all tiers, the time is in seconds and may not go back. It may wrap around at 2^32.
+// A second sample within the same second replaces the first at full resolution, the minute and hour include both.
+boolean SPS30_rollup::add(const Measurements *v, uint32_t time)
+{
+    if (!_empty && (int32_t)(time - _newest) < 0)
+    {
+        return false;
+    }
+
+    _seconds[time % ROLLUP_SECONDS] = *v;
+    _second_time[time % ROLLUP_SECONDS] = time;
+
+    fold(_minutes, ROLLUP_MINUTES, spans[ROLLUP_MINUTE], v, time);
+    fold(_hours, ROLLUP_HOURS, spans[ROLLUP_HOUR], v, time);
+
+    _newest = time;
+    _empty = false;
+
+    return true;
+}
+
+// query fills the buckets between from and to (in seconds) at the coarsest tier with buckets no longer than the resolution.
+// When the finer tier no longer reaches back to from, a coarser tier is used. Empty buckets are left out.
+// It returns the number of buckets, the tier that was used is returned in tier.
+uint16_t SPS30_rollup::query(uint32_t from, uint32_t to, uint32_t resolution, RollupBucket *buckets, uint16_t length, uint8_t *tier)
+{
+    uint8_t t = ROLLUP_SECOND;
+
+    while (t + 1 < ROLLUP_TIERS && spans[t + 1] <= resolution)
+    {
+        t++;
+    }
+
+    while (t + 1 < ROLLUP_TIERS && from < oldest(t))
+    {
+        t++;
+    }
+
+    if (tier != NULL)
+    {
+        *tier = t;
+    }
+
+    if (_empty || to < from)
+    {
+        return 0;
+    }
+
+    if (from < oldest(t)) // Nothing older is kept, so don't look for it.
+    {
+        from = oldest(t);
+    }
+
+    if (to > _newest)
+    {
+        to = _newest;
+    }
+
+    uint16_t count = 0;
+
+    for (uint32_t slot = from / spans[t]; slot <= to / spans[t] && count < length; slot++)
+    {
+        if (get_bucket(t, slot, &buckets[count]))
+        {
+            count++;
+        }
+    }
+
+    return count;
+}
+
+// fold adds a sample to the bucket of its time, a bucket left from an older period is started anew.
+void SPS30_rollup::fold(RollupBucket *ring, uint16_t length, uint32_t span, const Measurements *v, uint32_t time)
+{
+    RollupBucket *bucket = &ring[(time / span) % length];
+    uint32_t start = time - time % span;
+    const float *values = &v->MassPM1;
+
+    if (bucket->count == 0 || bucket->start != start)
+    {
+        bucket->start = start;
+        bucket->count = 0;
+
+        for (uint8_t c = 0; c < ROLLUP_CHANNELS; c++)
+        {
+            bucket->mean[c] = 0;
+            bucket->min[c] = values[c];
+            bucket->max[c] = values[c];
+        }
+    }
+
+    for (uint8_t c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        bucket->mean[c] += values[c];
+
+        if (values[c] < bucket->min[c])
+        {
+            bucket->min[c] = values[c];
+        }
+
+        if (values[c] > bucket->max[c])
+        {
+            bucket->max[c] = values[c];
+        }
+    }
+
+    if (bucket->count < 0xFFFF)
+    {
+        bucket->count++;
+    }
+}
+
+// get_bucket copies the bucket of a slot with its mean, it returns false when the slot has no samples.
+boolean SPS30_rollup::get_bucket(uint8_t tier, uint32_t slot, RollupBucket *bucket)
+{
+    if (tier == ROLLUP_SECOND)
+    {
+        uint16_t i = slot % ROLLUP_SECONDS;
+
+        if (_second_time[i] != slot)
+        {
+            return false;
+        }
+
+        const float *values = &_seconds[i].MassPM1;
+
+        bucket->start = slot;
+        bucket->count = 1;
+
+        for (uint8_t c = 0; c < ROLLUP_CHANNELS; c++)
+        {
+            bucket->mean[c] = bucket->min[c] = bucket->max[c] = values[c];
+        }
+
+        return true;
+    }
+
+    RollupBucket *ring = tier == ROLLUP_MINUTE ? _minutes : _hours;
+    RollupBucket *source = &ring[slot % lengths[tier]];
+
+    if (source->count == 0 || source->start != slot * spans[tier])
+    {
+        return false;
+    }
+
+    *bucket = *source;
+
+    for (uint8_t c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        bucket->mean[c] /= bucket->count;
+    }
+
+    return true;
+}
+
+// oldest returns the start of the oldest bucket a tier can still hold.
+uint32_t SPS30_rollup::oldest(uint8_t tier)
+{
+    uint32_t slot = _newest / spans[tier];
+
+    return slot >= lengths[tier] ? (slot - lengths[tier] + 1) * spans[tier] : 0;
+}
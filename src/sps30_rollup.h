@@ -0,0 +1,86 @@
+/**
+ * SPS30 - Rollup Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Keeps a history of the measurements in fixed RAM at three
+ * resolutions: the last minutes per second, the last hour per minute
+ * and the last day per hour, with the mean, min and max per channel.
+ * Every sample is folded into all tiers right away, so adding one
+ * takes constant time and nothing has to be compacted later.
+ *
+ * The time is given in seconds with every sample, an epoch time from
+ * an RTC or NTP for instance. millis() / 1000 is not suitable, it
+ * jumps back to 0 after 49 days.
+ *
+ * The default sizes take about 16 kB, lower them for small boards.
+ *********************************************************************
+*/
+
+#ifndef SPS30_ROLLUP_H
+#define SPS30_ROLLUP_H
+
+#include "sps30.h"
+
+#ifndef ROLLUP_SECONDS
+#define ROLLUP_SECONDS 120 // Samples kept at full resolution, 44 bytes each
+#endif
+
+#ifndef ROLLUP_MINUTES
+#define ROLLUP_MINUTES 60 // Minute buckets, 128 bytes each
+#endif
+
+#ifndef ROLLUP_HOURS
+#define ROLLUP_HOURS 24 // Hour buckets, 128 bytes each
+#endif
+
+#define ROLLUP_CHANNELS 10 // Number of floats in a Measurements struct
+
+enum rollup_tiers
+{
+    ROLLUP_SECOND,
+    ROLLUP_MINUTE,
+    ROLLUP_HOUR,
+    ROLLUP_TIERS
+};
+
+// The rollup bucket struct aggregates the samples of one second, minute or hour.
+struct RollupBucket
+{
+    uint32_t start; // Time of the start of the bucket [s]
+    uint16_t count; // Samples in the bucket
+    float mean[ROLLUP_CHANNELS]; // Kept as the sum until a query hands it out
+    float min[ROLLUP_CHANNELS];
+    float max[ROLLUP_CHANNELS];
+};
+
+class SPS30_rollup
+{
+public:
+    SPS30_rollup();
+
+    boolean add(const Measurements *v, uint32_t time);
+    uint16_t query(uint32_t from, uint32_t to, uint32_t resolution, RollupBucket *buckets, uint16_t length, uint8_t *tier = NULL);
+    void clear();
+
+private:
+    Measurements _seconds[ROLLUP_SECONDS];
+    uint32_t _second_time[ROLLUP_SECONDS]; // Time of every sample, to recognise overwritten slots
+    RollupBucket _minutes[ROLLUP_MINUTES];
+    RollupBucket _hours[ROLLUP_HOURS];
+
+    uint32_t _newest = 0; // Time of the newest sample
+    boolean _empty = true;
+
+    void fold(RollupBucket *ring, uint16_t length, uint32_t span, const Measurements *v, uint32_t time);
+    boolean get_bucket(uint8_t tier, uint32_t slot, RollupBucket *bucket);
+    uint32_t oldest(uint8_t tier);
+};
+#endif
@@ -0,0 +1,179 @@
+/**
+ * SPS30 - Sampler Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_sampler.h"
+
+#define PERIOD_WEIGHT 8 // The measured period is averaged with a weight of 1/8
+
+SPS30_sampler::SPS30_sampler(SPS30 *sensor)
+{
+    _sensor = sensor;
+    clear();
+}
+
+// clear forgets the phase and drift, the sampler looks for the samples from scratch.
+void SPS30_sampler::clear()
+{
+    _period = MEASUREMENT_INTERVAL_MS;
+    _brackets = 0;
+    _missed = false;
+    _misses = 0;
+    _next = millis();
+    _reads = 0;
+    _wasted = 0;
+}
+
+// poll checks for a new sample when one is due, it returns true with the values and the estimated sample time when there is one.
+SPS30_value<boolean> SPS30_sampler::poll(Measurements *v, uint32_t *time, uint32_t now)
+{
+    if ((int32_t)(now - _next) < 0)
+    {
+        return SPS30_value<boolean>(SPS30_status(), false);
+    }
+
+    SPS30_value<boolean> fresh = check(v);
+
+    if (!fresh.ok())
+    {
+        _next = now + SAMPLER_POLL_MS;
+        return fresh;
+    }
+
+    if (!fresh.value)
+    {
+        _wasted++;
+        _miss = now;
+        _missed = true;
+        _next = now + SAMPLER_POLL_MS;
+
+        if (++_misses >= SAMPLER_MAX_MISSES) // The sensor was stopped or restarted, the phase is lost.
+        {
+            _brackets = 0;
+            _misses = 0;
+        }
+
+        return fresh;
+    }
+
+    _reads++;
+    _misses = 0;
+
+    uint32_t sample;
+
+    if (!_sensor->has_data_ready()) // Over UART a read tells nothing about the time of the sample.
+    {
+        sample = now;
+    }
+    else if (_missed && now - _miss <= 2 * SAMPLER_POLL_MS) // The sample came between the two checks.
+    {
+        sample = _miss + (now - _miss) / 2;
+
+        if (_brackets == 0)
+        {
+            _anchor = sample;
+        }
+        else
+        {
+            // Measure the period from the anchor, over many samples the error of a bracket hardly matters.
+            uint32_t elapsed = sample - _anchor;
+            uint32_t count = (elapsed + _period / 2) / _period;
+
+            if (count > 0)
+            {
+                _period += ((float)elapsed / count - _period) / PERIOD_WEIGHT;
+            }
+        }
+
+        if (_brackets < 0xFF)
+        {
+            _brackets++;
+        }
+    }
+    else if (locked())
+    {
+        // Not bracketed, so it came somewhere before this check. Assume a bit earlier than expected,
+        // the schedule then creeps forward until a check is early and brackets a sample again.
+        sample = _phase + (uint32_t)_period - SAMPLER_STEP_MS;
+
+        if ((int32_t)(now - sample) < 0)
+        {
+            sample = now;
+        }
+    }
+    else
+    {
+        sample = now; // Still looking, the next samples will be bracketed.
+    }
+
+    _phase = sample;
+    _missed = false;
+
+    if (locked())
+    {
+        _next = _phase + (uint32_t)_period + SAMPLER_GUARD_MS;
+    }
+    else if (!_sensor->has_data_ready())
+    {
+        _next = _phase + MEASUREMENT_INTERVAL_MS + SAMPLER_GUARD_MS; // After the read time of the previous read
+    }
+    else
+    {
+        _next = _phase + (uint32_t)_period - 2 * SAMPLER_POLL_MS; // Start early to bracket the next sample.
+    }
+
+    *time = sample;
+    return fresh;
+}
+
+// time_to_next returns the ms until poll wants to use the bus again.
+uint32_t SPS30_sampler::time_to_next(uint32_t now)
+{
+    int32_t wait = _next - now;
+
+    return wait > 0 ? wait : 0;
+}
+
+// check looks for a new sample and reads it. Over I2C the sensor flags a new sample, over UART
+// a new one is expected a measurement interval after the previous read.
+SPS30_value<boolean> SPS30_sampler::check(Measurements *v)
+{
+    // Without a running measurement there never is new data, start it like SPS30::get_values does.
+    if (!_sensor->is_started())
+    {
+        SPS30_status status = _sensor->start();
+
+        if (!status)
+        {
+            return SPS30_value<boolean>(status);
+        }
+
+        _brackets = 0; // The sensor samples with a new phase.
+        _misses = 0;
+    }
+
+    SPS30_value<boolean> ready = _sensor->read_data_ready();
+
+    if (!ready.ok() || !ready.value)
+    {
+        return ready;
+    }
+
+    SPS30_status status = _sensor->get_values(v);
+
+    if (!status)
+    {
+        return SPS30_value<boolean>(status);
+    }
+
+    return SPS30_value<boolean>(status, true);
+}
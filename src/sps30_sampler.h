@@ -0,0 +1,75 @@
+/**
+ * SPS30 - Sampler Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Reads a sensor just after it produced a new sample. The sampler
+ * learns when the sensor samples (its phase) and how long its second
+ * is on the host clock (its drift), and tags every measurement with
+ * the estimated time of the sample instead of the time of the read.
+ *
+ * A new sample is recognised by the data ready flag over I2C. Once
+ * locked the schedule creeps forward until a check comes too early,
+ * the early and the next check then bracket the sample. So only a few
+ * checks per minute are wasted.
+ *
+ * The UART interface has no data ready flag and a new sample may have
+ * the same values as the previous one, so over UART the phase can't be
+ * found: the sensor is read once per measurement interval and the
+ * values are tagged with the time of the read.
+ *
+ * Use one sampler per sensor and call poll often from the loop.
+ *********************************************************************
+*/
+
+#ifndef SPS30_SAMPLER_H
+#define SPS30_SAMPLER_H
+
+#include "sps30.h"
+
+#define SAMPLER_POLL_MS 10    // Wait between checks while looking for a new sample
+#define SAMPLER_GUARD_MS 10   // Read this long after the expected sample
+#define SAMPLER_STEP_MS 2     // The schedule creeps this much earlier every sample that isn't bracketed
+#define SAMPLER_BRACKETS 2    // Bracketed samples needed before the schedule is used
+#define SAMPLER_MAX_MISSES 200 // Checks without a new sample before looking for it again from scratch
+
+class SPS30_sampler
+{
+public:
+    SPS30_sampler(SPS30 *sensor);
+
+    SPS30_value<boolean> poll(Measurements *v, uint32_t *time, uint32_t now = millis());
+    uint32_t time_to_next(uint32_t now = millis());
+    void clear();
+
+    boolean locked() { return _brackets >= SAMPLER_BRACKETS; }
+    float get_period() { return _period; }
+    int32_t get_drift_ppm() { return (_period - MEASUREMENT_INTERVAL_MS) * (1000000.0 / MEASUREMENT_INTERVAL_MS); }
+    uint32_t get_read_count() { return _reads; }
+    uint32_t get_wasted_count() { return _wasted; }
+
+private:
+    SPS30 *_sensor;
+
+    float _period;      // Estimated sample period on the host clock [ms]
+    uint32_t _phase;    // Estimated time of the last sample
+    uint32_t _anchor;   // Time of the first bracketed sample the period is measured from
+    uint8_t _brackets;  // Bracketed samples so far, saturates
+    uint32_t _next;     // Time of the next check
+    uint32_t _miss;     // Time of the last check without a new sample
+    boolean _missed;    // The last check didn't find a new sample
+    uint16_t _misses;   // Consecutive checks without a new sample
+
+    uint32_t _reads;
+    uint32_t _wasted;
+
+    SPS30_value<boolean> check(Measurements *v);
+};
+#endif
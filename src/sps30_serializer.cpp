@@ -0,0 +1,342 @@
+/**
+ * SPS30 - Serializer Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_serializer.h"
+
+#define MAX_DECIMALS 6 // More decimals than a float holds don't add anything
+
+#define CBOR_UNSIGNED 0
+#define CBOR_TEXT 3
+#define CBOR_MAP 5
+#define CBOR_FLOAT32 0xFA
+#define CBOR_INDEFINITE_ARRAY 0x9F
+#define CBOR_BREAK 0xFF
+
+// Keys in the order of the Measurements struct.
+static const char *const keys[] = {"pm1", "pm2", "pm4", "pm10", "n0", "n1", "n2", "n4", "n10", "size"};
+
+// The same keys with the JSON punctuation around them, so each is written at once.
+static const char *const json_keys[] = {"{\"pm1\":", ",\"pm2\":", ",\"pm4\":", ",\"pm10\":", ",\"n0\":",
+                                        ",\"n1\":", ",\"n2\":", ",\"n4\":", ",\"n10\":", ",\"size\":"};
+
+SPS30_serializer::SPS30_serializer(Print *out, uint8_t format)
+{
+    _out = out;
+    _format = format;
+}
+
+SPS30_serializer::SPS30_serializer(uint8_t *buffer, uint16_t size, uint8_t format)
+{
+    _buffer = buffer;
+    _size = size;
+    _format = format;
+}
+
+// set_decimals sets the number of JSON decimals, CBOR always keeps the full float.
+void SPS30_serializer::set_decimals(uint8_t decimals)
+{
+    _decimals = decimals > MAX_DECIMALS ? MAX_DECIMALS : decimals;
+    _scale = 1;
+
+    for (uint8_t i = 0; i < _decimals; i++)
+    {
+        _scale *= 10;
+    }
+}
+
+// begin starts an array to batch records in, without it every add writes a single record.
+void SPS30_serializer::begin()
+{
+    _batch = true;
+    _records = 0;
+
+    if (_format == FORMAT_CBOR)
+    {
+        put((uint8_t)CBOR_INDEFINITE_ARRAY); // The number of records isn't known yet.
+    }
+    else
+    {
+        put((uint8_t)'[');
+    }
+}
+
+// add writes a record, the time is left out when it is 0 and the health when it is NULL.
+void SPS30_serializer::add(const Measurements *v, uint32_t time, const DeviceHealth *health)
+{
+    const float *values = &v->MassPM1;
+
+    if (_format == FORMAT_CBOR)
+    {
+        cbor_head(CBOR_MAP, 10 + (_serial != NULL) + (time != 0) + (health != NULL));
+
+        for (uint8_t c = 0; c < 10; c++)
+        {
+            cbor_text(keys[c]);
+            cbor_float(values[c]);
+        }
+
+        if (_serial != NULL)
+        {
+            cbor_text("sn");
+            cbor_text(_serial);
+        }
+
+        if (time != 0)
+        {
+            cbor_text("t");
+            cbor_head(CBOR_UNSIGNED, time);
+        }
+
+        if (health != NULL)
+        {
+            cbor_text("st");
+            cbor_head(CBOR_UNSIGNED, health->status_register);
+        }
+    }
+    else
+    {
+        if (_batch && _records > 0)
+        {
+            put((uint8_t)',');
+        }
+
+        for (uint8_t c = 0; c < 10; c++)
+        {
+            put(json_keys[c]);
+            json_float(values[c]);
+        }
+
+        if (_serial != NULL)
+        {
+            put(",\"sn\":");
+            json_text(_serial);
+        }
+
+        if (time != 0)
+        {
+            put(",\"t\":");
+            json_uint(time);
+        }
+
+        if (health != NULL)
+        {
+            put(",\"st\":");
+            json_uint(health->status_register);
+        }
+
+        put((uint8_t)'}');
+    }
+
+    _records++;
+}
+
+// end closes the array of a batch and returns the bytes written since the last clear.
+size_t SPS30_serializer::end()
+{
+    if (_batch)
+    {
+        put((uint8_t)(_format == FORMAT_CBOR ? CBOR_BREAK : ']'));
+        _batch = false;
+    }
+
+    return _length;
+}
+
+// clear starts again at the beginning of the buffer.
+void SPS30_serializer::clear()
+{
+    _length = 0;
+    _overflow = false;
+    _batch = false;
+    _records = 0;
+}
+
+// put writes bytes to the Print object or the buffer, what doesn't fit the buffer is dropped and flagged.
+void SPS30_serializer::put(const uint8_t *data, size_t length)
+{
+    if (_out != NULL)
+    {
+        _length += _out->write(data, length);
+        return;
+    }
+
+    if (_overflow || _length + length > _size) // Nothing is added after a part was dropped.
+    {
+        _overflow = true;
+        return;
+    }
+
+    memcpy(_buffer + _length, data, length);
+    _length += length;
+}
+
+// json_float writes a float with a fixed number of decimals, built from integer digits instead of through printf.
+// Values too large for that are written with an exponent, NaN and infinity as null.
+void SPS30_serializer::json_float(float value)
+{
+    if (isnan(value) || isinf(value))
+    {
+        put("null");
+        return;
+    }
+
+    char text[16];
+    uint8_t i = sizeof(text);
+    boolean negative = value < 0;
+    float magnitude = negative ? -value : value;
+    int8_t exponent = 0;
+
+    while (magnitude * _scale >= 4.0e9) // Keep the scaled value in an uint32_t.
+    {
+        magnitude /= 10;
+        exponent++;
+    }
+
+    if (exponent != 0)
+    {
+        uint8_t e = exponent;
+
+        do
+        {
+            text[--i] = '0' + e % 10;
+            e /= 10;
+        } while (e);
+        text[--i] = 'e';
+    }
+
+    uint32_t scaled = magnitude * _scale + 0.5;
+
+    for (uint8_t d = 0; d < _decimals; d++)
+    {
+        text[--i] = '0' + scaled % 10;
+        scaled /= 10;
+    }
+
+    if (_decimals != 0)
+    {
+        text[--i] = '.';
+    }
+
+    do
+    {
+        text[--i] = '0' + scaled % 10;
+        scaled /= 10;
+    } while (scaled);
+
+    if (negative)
+    {
+        text[--i] = '-';
+    }
+
+    put((const uint8_t *)text + i, sizeof(text) - i);
+}
+
+// json_text writes a quoted string, quotes, backslashes and control characters are escaped.
+void SPS30_serializer::json_text(const char *text)
+{
+    put((uint8_t)'"');
+
+    for (; *text != '\0'; text++)
+    {
+        uint8_t c = *text;
+
+        if (c == '"' || c == '\\')
+        {
+            uint8_t escaped[2] = {'\\', c};
+            put(escaped, sizeof(escaped));
+        }
+        else if (c < 0x20)
+        {
+            const char *hex = "0123456789abcdef";
+            uint8_t escaped[6] = {'\\', 'u', '0', '0', (uint8_t)hex[c >> 4], (uint8_t)hex[c & 0x0F]};
+            put(escaped, sizeof(escaped));
+        }
+        else
+        {
+            put(c);
+        }
+    }
+
+    put((uint8_t)'"');
+}
+
+void SPS30_serializer::json_uint(uint32_t value)
+{
+    char text[10];
+    uint8_t i = sizeof(text);
+
+    do
+    {
+        text[--i] = '0' + value % 10;
+        value /= 10;
+    } while (value);
+
+    put((const uint8_t *)text + i, sizeof(text) - i);
+}
+
+// cbor_head writes a major type with its argument in the shortest encoding.
+void SPS30_serializer::cbor_head(uint8_t major, uint32_t value)
+{
+    uint8_t head[5];
+    uint8_t length;
+
+    major <<= 5;
+
+    if (value < 24)
+    {
+        head[0] = major | value;
+        length = 1;
+    }
+    else if (value <= 0xFF)
+    {
+        head[0] = major | 24;
+        head[1] = value;
+        length = 2;
+    }
+    else if (value <= 0xFFFF)
+    {
+        head[0] = major | 25;
+        head[1] = value >> 8;
+        head[2] = value;
+        length = 3;
+    }
+    else
+    {
+        head[0] = major | 26;
+        head[1] = value >> 24;
+        head[2] = value >> 16;
+        head[3] = value >> 8;
+        head[4] = value;
+        length = 5;
+    }
+
+    put(head, length);
+}
+
+void SPS30_serializer::cbor_text(const char *text)
+{
+    size_t length = strlen(text);
+
+    cbor_head(CBOR_TEXT, length);
+    put((const uint8_t *)text, length);
+}
+
+// cbor_float writes a float in single precision, big endian like the sensor sends it.
+void SPS30_serializer::cbor_float(float value)
+{
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+
+    uint8_t data[5] = {CBOR_FLOAT32, (uint8_t)(bits >> 24), (uint8_t)(bits >> 16), (uint8_t)(bits >> 8), (uint8_t)bits};
+    put(data, sizeof(data));
+}
@@ -0,0 +1,80 @@
+/**
+ * SPS30 - Serializer Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Writes measurements as JSON or CBOR straight into a Print object
+ * (Serial, a network client, a file) or into a buffer, without using
+ * the heap. Several records can be batched in one array.
+ *
+ * Every record is an object/map with the keys pm1, pm2, pm4, pm10,
+ * n0, n1, n2, n4, n10 and size, optionally followed by sn (serial
+ * number), t (time) and st (raw status register).
+ *********************************************************************
+*/
+
+#ifndef SPS30_SERIALIZER_H
+#define SPS30_SERIALIZER_H
+
+#include "sps30.h"
+
+#define SERIALIZER_DECIMALS 2 // Default JSON decimals, the sensor resolution is lower
+
+enum serializer_formats
+{
+    FORMAT_JSON,
+    FORMAT_CBOR // RFC 8949, floats are encoded in single precision
+};
+
+class SPS30_serializer
+{
+public:
+    SPS30_serializer(Print *out, uint8_t format = FORMAT_JSON);
+    SPS30_serializer(uint8_t *buffer, uint16_t size, uint8_t format = FORMAT_JSON);
+
+    void set_serial(const char *serial) { _serial = serial; }
+    void set_decimals(uint8_t decimals);
+
+    void begin();
+    void add(const Measurements *v, uint32_t time = 0, const DeviceHealth *health = NULL);
+    size_t end();
+
+    void clear();
+    size_t length() { return _length; }
+    boolean overflow() { return _overflow; }
+
+private:
+    Print *_out = NULL;
+    uint8_t *_buffer = NULL; // Used when there is no Print object
+    uint16_t _size = 0;
+
+    uint8_t _format;
+    uint8_t _decimals = SERIALIZER_DECIMALS;
+    uint32_t _scale = 100;       // 10 ^ decimals
+    const char *_serial = NULL;  // Added to every record when set
+
+    size_t _length = 0;          // Bytes written since the last clear
+    boolean _overflow = false;   // The buffer was too small
+    boolean _batch = false;      // Records are added to an array
+    uint16_t _records = 0;       // Records in the current array
+
+    void put(const uint8_t *data, size_t length);
+    void put(const char *text) { put((const uint8_t *)text, strlen(text)); }
+    void put(uint8_t value) { put(&value, 1); }
+
+    void json_float(float value);
+    void json_uint(uint32_t value);
+    void json_text(const char *text);
+
+    void cbor_head(uint8_t major, uint32_t value);
+    void cbor_text(const char *text);
+    void cbor_float(float value);
+};
+#endif
@@ -0,0 +1,98 @@
+/**
+ * SPS30 - Snapshot Library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_snapshot.h"
+
+#define SNAPSHOT_WORDS (sizeof(SnapshotData) / sizeof(uint32_t))
+#define STATUS_WORD (offsetof(SnapshotData, status_register) / sizeof(uint32_t))
+#define COUNT_WORD (offsetof(SnapshotData, count) / sizeof(uint32_t))
+
+// Constructor, the snapshot starts empty. In shared memory that is filled with zeros no constructor is needed.
+SPS30_snapshot::SPS30_snapshot()
+{
+    _sequence = 0;
+    memset(_data, 0, sizeof(_data));
+}
+
+// publish writes a new snapshot, there may only be one writer.
+// The health is optional, without it the status register of the previous snapshot is kept.
+void SPS30_snapshot::publish(const Measurements *v, uint32_t time, const DeviceHealth *health)
+{
+    SnapshotData data;
+    uint32_t words[SNAPSHOT_WORDS];
+    uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+
+    data.values = *v;
+    data.status_register = health != NULL ? health->status_register : __atomic_load_n(&_data[STATUS_WORD], __ATOMIC_RELAXED);
+    data.time = time;
+    data.count = __atomic_load_n(&_data[COUNT_WORD], __ATOMIC_RELAXED) + 1;
+    memcpy(words, &data, sizeof(words));
+
+    __atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED); // Odd: readers retry.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (uint8_t i = 0; i < SNAPSHOT_WORDS; i++)
+    {
+        __atomic_store_n(&_data[i], words[i], __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
+
+// read copies the latest snapshot, it returns false when the writer overtook every try or nothing was published yet.
+// The tries are limited, so a reader that interrupts the writer on the same core doesn't wait forever.
+boolean SPS30_snapshot::read(SnapshotData *data, uint8_t tries)
+{
+    uint32_t words[SNAPSHOT_WORDS];
+
+    while (tries-- > 0)
+    {
+        uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_ACQUIRE);
+
+        if (sequence & 0x01) // Being written.
+        {
+            continue;
+        }
+
+        for (uint8_t i = 0; i < SNAPSHOT_WORDS; i++)
+        {
+            words[i] = __atomic_load_n(&_data[i], __ATOMIC_RELAXED);
+        }
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&_sequence, __ATOMIC_RELAXED) == sequence)
+        {
+            memcpy(data, words, sizeof(words));
+            return data->count != 0;
+        }
+    }
+
+    return false;
+}
+
+// clear empties the snapshot, like publish it may only be called by the writer.
+void SPS30_snapshot::clear()
+{
+    uint32_t sequence = __atomic_load_n(&_sequence, __ATOMIC_RELAXED);
+
+    __atomic_store_n(&_sequence, sequence + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    for (uint8_t i = 0; i < SNAPSHOT_WORDS; i++)
+    {
+        __atomic_store_n(&_data[i], 0, __ATOMIC_RELAXED);
+    }
+
+    __atomic_store_n(&_sequence, sequence + 2, __ATOMIC_RELEASE);
+}
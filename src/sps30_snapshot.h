@@ -0,0 +1,57 @@
+/**
+ * SPS30 - Snapshot Library Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Publishes the latest measurement with a seqlock: one writer, any
+ * number of readers, no locks and no waiting for the writer. A reader
+ * copies the snapshot and retries when it was written meanwhile.
+ *
+ * The snapshot only holds 32 bit words and no pointers, so it can be
+ * shared between ESP32 cores and tasks, read in an interrupt, or be
+ * placed in shared memory (POSIX shm_open + mmap) and read by other
+ * processes. Memory filled with zeros is an empty snapshot.
+ *********************************************************************
+*/
+
+#ifndef SPS30_SNAPSHOT_H
+#define SPS30_SNAPSHOT_H
+
+#include "sps30.h"
+
+#define SNAPSHOT_TRIES 4 // Reads that may be overtaken by the writer before giving up
+
+// The snapshot data struct is what a reader gets.
+struct SnapshotData
+{
+    Measurements values;
+    uint32_t status_register; // Raw status register, 0 if none was published
+    uint32_t time;            // Time given to publish
+    uint32_t count;           // Number of measurements published, 0 when empty
+};
+
+// The snapshot is copied word by word, so a reader never sees half a word.
+static_assert(sizeof(SnapshotData) % sizeof(uint32_t) == 0, "SnapshotData must consist of 32 bit words");
+
+class SPS30_snapshot
+{
+public:
+    SPS30_snapshot();
+
+    void publish(const Measurements *v, uint32_t time, const DeviceHealth *health = NULL);
+    boolean read(SnapshotData *data, uint8_t tries = SNAPSHOT_TRIES);
+    void clear();
+
+private:
+    uint32_t _sequence; // Odd while the writer is busy
+    uint32_t _data[sizeof(SnapshotData) / sizeof(uint32_t)];
+};
+
+#endif
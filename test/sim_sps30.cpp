@@ -0,0 +1,552 @@
+/**
+ * SPS30 - Simulated sensor
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+
+#define STATE_OK 0x00
+#define STATE_LENGTH 0x01
+#define STATE_COMMAND 0x02
+#define STATE_NOT_ALLOWED 0x43
+
+SimSPS30::SimSPS30()
+{
+    memset(values, 0, sizeof(values));
+}
+
+uint8_t sim_crc(const uint8_t *data)
+{
+    uint8_t crc = 0xFF;
+
+    for (int i = 0; i < 2; i++)
+    {
+        crc ^= data[i];
+
+        for (int bit = 0; bit < 8; bit++)
+        {
+            crc = crc & 0x80 ? (crc << 1) ^ 0x31 : crc << 1;
+        }
+    }
+
+    return crc;
+}
+
+// set_values stores floats as the sensor sends them: big endian.
+void SimSPS30::set_values(const float *measurements)
+{
+    for (int i = 0; i < 10; i++)
+    {
+        uint32_t bits;
+        memcpy(&bits, &measurements[i], sizeof(bits));
+
+        for (int b = 0; b < 4; b++)
+        {
+            values[i * 4 + b] = bits >> (24 - 8 * b);
+        }
+    }
+}
+
+uint32_t SimSPS30::sample_index()
+{
+    return measuring ? (host_time_us - _start_time) / 1000 / SIM_SAMPLE_MS : 0;
+}
+
+boolean SimSPS30::cleaning()
+{
+    return _cleaned && host_time_us - _cleaning_time < (uint64_t)SIM_CLEANING_MS * 1000;
+}
+
+void SimSPS30::start()
+{
+    if (!measuring)
+    {
+        measuring = true;
+        _start_time = host_time_us;
+        _read_index = 0;
+    }
+}
+
+// size_t info fills the product type or serial number, including the terminating zero.
+size_t SimSPS30::info(uint8_t type, uint8_t *data)
+{
+    const char *text = type == 0x00 ? "00080000" : "SIM0000000000001";
+    size_t length = strlen(text) + 1;
+
+    memcpy(data, text, length);
+
+    return length;
+}
+
+void SimSPS30::received(HardwareSerial *port, uint8_t value)
+{
+    if (!_in_frame)
+    {
+        if (value == 0x7E)
+        {
+            _in_frame = true;
+            _frame_length = 0;
+            _stuffed = false;
+        }
+        else if (sleeping && value == 0xFF)
+        {
+            _pulse = true;
+        }
+
+        return;
+    }
+
+    if (value == 0x7E)
+    {
+        if (_frame_length == 0) // Two headers in a row, the second one starts the frame.
+        {
+            return;
+        }
+
+        _in_frame = false;
+        shdlc_frame(port);
+        return;
+    }
+
+    if (value == 0x7D)
+    {
+        _stuffed = true;
+        return;
+    }
+
+    if (_stuffed)
+    {
+        value ^= 0x20;
+        _stuffed = false;
+    }
+
+    if (_frame_length < sizeof(_frame))
+    {
+        _frame[_frame_length++] = value;
+    }
+}
+
+// shdlc_frame handles a complete MOSI frame: address, command, length, data and checksum.
+void SimSPS30::shdlc_frame(HardwareSerial *port)
+{
+    if (_frame_length < 4)
+    {
+        return;
+    }
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i + 1 < _frame_length; i++)
+    {
+        sum += _frame[i];
+    }
+
+    uint8_t command = _frame[1];
+    uint8_t length = _frame[2];
+    const uint8_t *data = &_frame[3];
+
+    if ((uint8_t)~sum != _frame[_frame_length - 1] || length != _frame_length - 4)
+    {
+        return; // The sensor ignores broken frames.
+    }
+
+    if (sleeping)
+    {
+        if (!_pulse || command != 0x11)
+        {
+            return; // The UART is off.
+        }
+
+        _pulse = false;
+    }
+
+    commands.push_back(command);
+
+    if (drop > 0)
+    {
+        drop--;
+        return;
+    }
+
+    uint8_t answer[64];
+    uint8_t size = 0;
+    uint8_t state = STATE_OK;
+    uint16_t firmware = firmware_major << 8 | firmware_minor;
+
+    switch (command)
+    {
+    case 0x00: // Start measurement
+        if (length != 2)
+        {
+            state = STATE_LENGTH;
+        }
+        else
+        {
+            start();
+        }
+        break;
+
+    case 0x01: // Stop measurement
+        measuring = false;
+        break;
+
+    case 0x03: // Read measured values
+        if (!measuring)
+        {
+            state = STATE_NOT_ALLOWED;
+            break;
+        }
+        memcpy(answer, values, sizeof(values));
+        size = sizeof(values);
+        value_reads++;
+        break;
+
+    case 0x10: // Sleep
+        if (firmware < 0x0200)
+        {
+            state = STATE_COMMAND;
+        }
+        else if (measuring)
+        {
+            state = STATE_NOT_ALLOWED;
+        }
+        else
+        {
+            sleeping = true;
+            _pulse = false;
+        }
+        break;
+
+    case 0x11: // Wake up
+        if (firmware < 0x0200)
+        {
+            state = STATE_COMMAND;
+        }
+        sleeping = false;
+        break;
+
+    case 0x56: // Start fan cleaning
+        if (!measuring)
+        {
+            state = STATE_NOT_ALLOWED;
+            break;
+        }
+        cleanings++;
+        _cleaned = true;
+        _cleaning_time = host_time_us;
+        break;
+
+    case 0x80: // Read or write the auto cleaning interval
+        if (length == 1)
+        {
+            for (int b = 0; b < 4; b++)
+            {
+                answer[size++] = auto_clean_interval >> (24 - 8 * b);
+            }
+        }
+        else if (length == 5)
+        {
+            auto_clean_interval = (uint32_t)data[1] << 24 | (uint32_t)data[2] << 16 | (uint32_t)data[3] << 8 | data[4];
+        }
+        else
+        {
+            state = STATE_LENGTH;
+        }
+        break;
+
+    case 0xD0: // Device information
+        size = length == 1 ? info(data[0], answer) : 0;
+        break;
+
+    case 0xD1: // Version
+    {
+        const uint8_t version[] = {firmware_major, firmware_minor, 0, 7, 0, 2, 0};
+        memcpy(answer, version, sizeof(version));
+        size = sizeof(version);
+        break;
+    }
+
+    case 0xD2: // Status register
+        if (firmware < 0x0202)
+        {
+            state = STATE_COMMAND;
+            break;
+        }
+        for (int b = 0; b < 4; b++)
+        {
+            answer[size++] = status_register >> (24 - 8 * b);
+        }
+        answer[size++] = 0;
+        if (length == 1 && data[0] == 1)
+        {
+            status_register = 0;
+        }
+        break;
+
+    case 0xD3: // Reset
+        measuring = false;
+        sleeping = false;
+        break;
+
+    default:
+        state = STATE_COMMAND;
+        break;
+    }
+
+    shdlc_answer(port, command, state, answer, size);
+}
+
+// shdlc_answer sends a stuffed MISO frame after the latency.
+void SimSPS30::shdlc_answer(HardwareSerial *port, uint8_t command, uint8_t state, const uint8_t *data, uint8_t length)
+{
+    uint8_t raw[4 + 255 + 1];
+    size_t size = 0;
+
+    raw[size++] = 0x00;
+    raw[size++] = command;
+    raw[size++] = state;
+    raw[size++] = length;
+    memcpy(&raw[size], data, length);
+    size += length;
+
+    uint8_t sum = 0;
+    for (size_t i = 0; i < size; i++)
+    {
+        sum += raw[i];
+    }
+    raw[size++] = ~sum;
+
+    if (corrupt > 0)
+    {
+        corrupt--;
+        raw[size - 1] ^= 0x01;
+    }
+
+    uint8_t frame[2 * sizeof(raw) + 2];
+    size_t out = 0;
+
+    frame[out++] = 0x7E;
+    for (size_t i = 0; i < size; i++)
+    {
+        uint8_t value = raw[i];
+
+        if (value == 0x7E || value == 0x7D || value == 0x11 || value == 0x13)
+        {
+            frame[out++] = 0x7D;
+            value ^= 0x20;
+        }
+
+        frame[out++] = value;
+    }
+    frame[out++] = 0x7E;
+
+    port->respond(frame, out, latency_us);
+}
+
+// i2c_answer sets what the next read returns, every 2 bytes followed by their CRC.
+void SimSPS30::i2c_answer(const uint8_t *data, size_t length)
+{
+    _answer_length = 0;
+
+    for (size_t i = 0; i < length && _answer_length + 3 <= sizeof(_answer); i += 2)
+    {
+        uint8_t word[2] = {data[i], i + 1 < length ? data[i + 1] : (uint8_t)0};
+
+        _answer[_answer_length++] = word[0];
+        _answer[_answer_length++] = word[1];
+        _answer[_answer_length++] = sim_crc(word);
+    }
+
+    if (corrupt > 0 && _answer_length > 0)
+    {
+        corrupt--;
+        _answer[2] ^= 0x01;
+    }
+
+    _answer_time = host_time_us + latency_us;
+}
+
+uint8_t SimSPS30::transmission(uint8_t address, const uint8_t *data, size_t length)
+{
+    if (address != SIM_I2C_ADDRESS)
+    {
+        return 2;
+    }
+
+    if (sleeping)
+    {
+        // A sleeping sensor NACKs, but the first transmission wakes up its interface for the wake up command.
+        if (!_pulse)
+        {
+            _pulse = true;
+            return 2;
+        }
+
+        if (length < 2 || (data[0] << 8 | data[1]) != 0x1103)
+        {
+            return 2;
+        }
+    }
+
+    if (length == 0) // Wake up pulse on an awake sensor.
+    {
+        return 0;
+    }
+
+    if (nack > 0)
+    {
+        nack--;
+        return 2;
+    }
+
+    if (length < 2)
+    {
+        return 3;
+    }
+
+    uint16_t command = data[0] << 8 | data[1];
+    uint16_t firmware = firmware_major << 8 | firmware_minor;
+    uint8_t answer[48];
+    size_t size = 0;
+
+    commands.push_back(command);
+    _answer_length = 0;
+
+    switch (command)
+    {
+    case 0x0010: // Start measurement
+        start();
+        break;
+
+    case 0x0104: // Stop measurement
+        measuring = false;
+        break;
+
+    case 0x0202: // Data ready
+        answer[size++] = 0x00;
+        answer[size++] = measuring && sample_index() > _read_index ? 0x01 : 0x00;
+        break;
+
+    case 0x0300: // Read measured values
+        if (!measuring)
+        {
+            return 2;
+        }
+        memcpy(answer, values, sizeof(values));
+        size = sizeof(values);
+        _read_index = sample_index();
+        value_reads++;
+        break;
+
+    case 0x1001: // Sleep
+        if (firmware < 0x0200 || measuring)
+        {
+            return 2;
+        }
+        sleeping = true;
+        _pulse = false;
+        break;
+
+    case 0x1103: // Wake up
+        if (firmware < 0x0200)
+        {
+            return 2;
+        }
+        sleeping = false;
+        _pulse = false;
+        break;
+
+    case 0x5607: // Start fan cleaning
+        if (!measuring)
+        {
+            return 2;
+        }
+        cleanings++;
+        _cleaned = true;
+        _cleaning_time = host_time_us;
+        break;
+
+    case 0x8004: // Read or write the auto cleaning interval
+        if (length == 8)
+        {
+            auto_clean_interval = (uint32_t)data[2] << 24 | (uint32_t)data[3] << 16 | (uint32_t)data[5] << 8 | data[6];
+        }
+        for (int b = 0; b < 4; b++)
+        {
+            answer[size++] = auto_clean_interval >> (24 - 8 * b);
+        }
+        break;
+
+    case 0xD002: // Product type
+    case 0xD033: // Serial number
+        memset(answer, 0, 32);
+        info(command == 0xD002 ? 0x00 : 0x03, answer);
+        size = 32;
+        break;
+
+    case 0xD100: // Version
+        answer[size++] = firmware_major;
+        answer[size++] = firmware_minor;
+        break;
+
+    case 0xD206: // Status register
+        if (firmware < 0x0202)
+        {
+            return 2;
+        }
+        for (int b = 0; b < 4; b++)
+        {
+            answer[size++] = status_register >> (24 - 8 * b);
+        }
+        break;
+
+    case 0xD210: // Clear status register
+        if (firmware < 0x0200)
+        {
+            return 2;
+        }
+        status_register = 0;
+        break;
+
+    case 0xD304: // Reset
+        measuring = false;
+        sleeping = false;
+        break;
+
+    default:
+        return 2;
+    }
+
+    if (size > 0)
+    {
+        i2c_answer(answer, size);
+    }
+
+    return 0;
+}
+
+size_t SimSPS30::request(uint8_t address, uint8_t *data, size_t length)
+{
+    if (address != SIM_I2C_ADDRESS || sleeping || _answer_length == 0 || host_time_us < _answer_time)
+    {
+        return 0; // The sensor doesn't acknowledge until the answer is ready.
+    }
+
+    if (drop > 0)
+    {
+        drop--;
+        return 0;
+    }
+
+    size_t size = length < _answer_length ? length : _answer_length;
+    memcpy(data, _answer, size);
+
+    return size;
+}
@@ -0,0 +1,99 @@
+/**
+ * SPS30 - Simulated sensor Header file
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * A SPS30 on the host: it answers the SHDLC frames on a serial port
+ * and the I2C commands on the bus like the sensor does, on the host
+ * clock. Tests set its values, firmware and faults, and look at the
+ * commands it got.
+ *********************************************************************
+*/
+
+#ifndef SIM_SPS30_H
+#define SIM_SPS30_H
+
+#include <vector>
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define SIM_I2C_ADDRESS 0x69
+#define SIM_SAMPLE_MS 1000       // A new measurement every second
+#define SIM_CLEANING_MS 10000    // A fan cleaning takes 10 s
+#define SIM_LATENCY_US 2000      // Time the sensor takes to answer
+
+class SimSPS30 : public HostSerialDevice, public HostWireDevice
+{
+public:
+    SimSPS30();
+
+    void attach(HardwareSerial *port) { port->attach(this); }
+    void attach(TwoWire *wire) { wire->attach(this); }
+
+    // Sensor state, the tests may change it directly.
+    uint8_t firmware_major = 2;
+    uint8_t firmware_minor = 2;
+    boolean measuring = false;
+    boolean sleeping = false;
+    uint32_t status_register = 0;
+    uint32_t auto_clean_interval = 604800;
+    uint32_t latency_us = SIM_LATENCY_US;
+    uint8_t values[40]; // The measured values as they go over the wire, big endian
+
+    // Faults for the next frame or transmission.
+    uint8_t drop = 0;     // Frames that get no answer
+    uint8_t corrupt = 0;  // Answers with a bad CRC
+    uint8_t nack = 0;     // I2C transmissions that aren't acknowledged
+
+    // What the sensor saw.
+    std::vector<uint16_t> commands; // SHDLC command bytes or I2C command words, in order
+    uint32_t cleanings = 0;
+    uint32_t value_reads = 0;
+
+    void set_values(const float *measurements);
+    uint32_t sample_index(); // Measurements taken since the start
+    boolean cleaning();      // The fan is being cleaned
+
+    // HostSerialDevice
+    void received(HardwareSerial *port, uint8_t value);
+
+    // HostWireDevice
+    uint8_t transmission(uint8_t address, const uint8_t *data, size_t length);
+    size_t request(uint8_t address, uint8_t *data, size_t length);
+
+private:
+    // SHDLC receiver.
+    uint8_t _frame[600];
+    size_t _frame_length = 0;
+    boolean _in_frame = false;
+    boolean _stuffed = false;
+    boolean _pulse = false; // A wake up pulse was received while sleeping
+
+    uint64_t _start_time = 0;
+    uint64_t _cleaning_time = 0;
+    boolean _cleaned = false;
+    uint32_t _read_index = 0; // Sample of the last I2C read
+
+    // I2C pointer and answer.
+    uint8_t _answer[64];
+    size_t _answer_length = 0;
+    uint64_t _answer_time = 0;
+
+    void start();
+    void shdlc_frame(HardwareSerial *port);
+    void shdlc_answer(HardwareSerial *port, uint8_t command, uint8_t state, const uint8_t *data, uint8_t length);
+    void i2c_answer(const uint8_t *data, size_t length);
+    size_t info(uint8_t type, uint8_t *data);
+};
+
+uint8_t sim_crc(const uint8_t *data); // Sensirion CRC8 of two bytes
+
+#endif
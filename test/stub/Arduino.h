@@ -0,0 +1,129 @@
+/**
+ * SPS30 - Host stand-in for the Arduino core
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Just enough of the Arduino core to build and test the library on a
+ * PC. The clock only moves when it is read, by delay or by a test, so
+ * every run is the same. A simulated device can be attached to a
+ * serial port to answer the frames the library sends.
+ *********************************************************************
+*/
+
+#ifndef HOST_ARDUINO_H
+#define HOST_ARDUINO_H
+
+#include <math.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <deque>
+
+typedef bool boolean;
+typedef uint8_t byte;
+
+#define BIN 2
+#define OCT 8
+#define DEC 10
+#define HEX 16
+
+#define F(string) (string)
+
+// The host clock in us. Every read of the clock takes 1 us, so busy waits always end.
+extern uint64_t host_time_us;
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+class Print
+{
+public:
+    virtual ~Print() {}
+
+    virtual size_t write(uint8_t value) = 0;
+    virtual size_t write(const uint8_t *buffer, size_t size);
+    size_t write(const char *text) { return text == NULL ? 0 : write((const uint8_t *)text, strlen(text)); }
+    virtual int availableForWrite() { return 0; }
+    virtual void flush() {}
+
+    size_t print(const char *text) { return write(text); }
+    size_t print(char value) { return write((uint8_t)value); }
+    size_t print(unsigned char value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(int value, int base = DEC) { return print((long)value, base); }
+    size_t print(unsigned int value, int base = DEC) { return print((unsigned long)value, base); }
+    size_t print(long value, int base = DEC);
+    size_t print(unsigned long value, int base = DEC);
+    size_t print(double value, int digits = 2);
+
+    size_t println() { return write("\r\n"); }
+    template <typename T>
+    size_t println(T value) { return print(value) + println(); }
+    template <typename T>
+    size_t println(T value, int format) { return print(value, format) + println(); }
+};
+
+class Stream : public Print
+{
+public:
+    virtual int available() = 0;
+    virtual int read() = 0;
+    virtual int peek() = 0;
+};
+
+class HardwareSerial;
+
+// A simulated device behind a serial port, it gets every byte the library sends.
+class HostSerialDevice
+{
+public:
+    virtual ~HostSerialDevice() {}
+    virtual void received(HardwareSerial *port, uint8_t value) = 0;
+};
+
+class HardwareSerial : public Stream
+{
+public:
+    void begin(unsigned long baud) { (void)baud; }
+    void end() {}
+    operator bool() { return true; }
+
+    size_t write(uint8_t value);
+    using Print::write;
+    int availableForWrite() { return 64; }
+    int available();
+    int read();
+    int peek();
+
+    // Host side: attach a device, or hand bytes to the library after a delay.
+    void attach(HostSerialDevice *device) { _device = device; }
+    void respond(const uint8_t *data, size_t length, uint32_t delay_us = 0);
+    void clear() { _rx.clear(); }
+
+private:
+    struct Pending
+    {
+        uint64_t time; // Host time the byte arrives
+        uint8_t value;
+    };
+
+    HostSerialDevice *_device = NULL;
+    std::deque<Pending> _rx;
+};
+
+extern HardwareSerial Serial;
+extern HardwareSerial Serial1;
+
+#endif
@@ -0,0 +1,77 @@
+/**
+ * SPS30 - Host stand-in for the Wire library
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * An I2C bus without hardware: transmissions and reads go to a
+ * simulated device, without one every address NACKs.
+ *********************************************************************
+*/
+
+#ifndef HOST_WIRE_H
+#define HOST_WIRE_H
+
+#include "Arduino.h"
+
+#ifndef BUFFER_LENGTH
+#define BUFFER_LENGTH 32 // Like the AVR core, override with -DBUFFER_LENGTH=64
+#endif
+
+// A simulated device on the bus.
+class HostWireDevice
+{
+public:
+    virtual ~HostWireDevice() {}
+
+    // transmission returns 0 when the address and data were acknowledged, 2 or 3 for a NACK.
+    virtual uint8_t transmission(uint8_t address, const uint8_t *data, size_t length) = 0;
+
+    // request fills up to length bytes and returns how many, 0 for a NACK.
+    virtual size_t request(uint8_t address, uint8_t *data, size_t length) = 0;
+};
+
+class TwoWire : public Stream
+{
+public:
+    void begin() {}
+    void setClock(uint32_t frequency) { (void)frequency; }
+
+    void beginTransmission(uint8_t address);
+    void beginTransmission(int address) { beginTransmission((uint8_t)address); }
+    uint8_t endTransmission(bool stop = true);
+
+    uint8_t requestFrom(uint8_t address, uint8_t quantity);
+    uint8_t requestFrom(int address, int quantity) { return requestFrom((uint8_t)address, (uint8_t)quantity); }
+
+    size_t write(uint8_t value);
+    size_t write(const uint8_t *buffer, size_t size);
+    int available() { return _rx_length - _rx_position; }
+    int read() { return _rx_position < _rx_length ? _rx[_rx_position++] : -1; }
+    int peek() { return _rx_position < _rx_length ? _rx[_rx_position] : -1; }
+
+    // Host side.
+    void attach(HostWireDevice *device) { _device = device; }
+    uint32_t get_transmission_count() { return _transmissions; }
+
+private:
+    HostWireDevice *_device = NULL;
+    uint8_t _address = 0;
+    uint8_t _tx[BUFFER_LENGTH];
+    size_t _tx_length = 0;
+    boolean _tx_overflow = false;
+    uint8_t _rx[BUFFER_LENGTH];
+    size_t _rx_length = 0;
+    size_t _rx_position = 0;
+    uint32_t _transmissions = 0;
+};
+
+extern TwoWire Wire;
+
+#endif
@@ -0,0 +1,221 @@
+/**
+ * SPS30 - Host stand-in for the Arduino core
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "Arduino.h"
+#include "Wire.h"
+
+#define SERIAL_POLL_US 10 // Time a poll of a serial port takes
+
+uint64_t host_time_us = 0;
+
+HardwareSerial Serial;
+HardwareSerial Serial1;
+TwoWire Wire;
+
+unsigned long millis()
+{
+    host_time_us++;
+    return (unsigned long)(host_time_us / 1000);
+}
+
+unsigned long micros()
+{
+    host_time_us++;
+    return (unsigned long)host_time_us;
+}
+
+void delay(unsigned long ms)
+{
+    host_time_us += (uint64_t)ms * 1000;
+}
+
+void delayMicroseconds(unsigned int us)
+{
+    host_time_us += us;
+}
+
+void yield()
+{
+}
+
+size_t Print::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+
+    while (size-- > 0 && write(*buffer++) == 1)
+    {
+        written++;
+    }
+
+    return written;
+}
+
+size_t Print::print(long value, int base)
+{
+    if (base == DEC && value < 0)
+    {
+        return print('-') + print((unsigned long)-value, DEC);
+    }
+
+    return print((unsigned long)value, base);
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+    char buffer[8 * sizeof(long) + 1];
+    char *p = &buffer[sizeof(buffer) - 1];
+
+    if (base < 2)
+    {
+        base = DEC;
+    }
+
+    *p = '\0';
+    do
+    {
+        uint8_t digit = value % base;
+        *--p = digit < 10 ? '0' + digit : 'A' + digit - 10;
+        value /= base;
+    } while (value != 0);
+
+    return write(p);
+}
+
+size_t Print::print(double value, int digits)
+{
+    char buffer[64];
+
+    snprintf(buffer, sizeof(buffer), "%.*f", digits, value);
+
+    return write(buffer);
+}
+
+size_t HardwareSerial::write(uint8_t value)
+{
+    if (_device != NULL)
+    {
+        _device->received(this, value);
+    }
+
+    return 1;
+}
+
+int HardwareSerial::available()
+{
+    host_time_us += SERIAL_POLL_US;
+
+    size_t count = 0;
+
+    while (count < _rx.size() && _rx[count].time <= host_time_us)
+    {
+        count++;
+    }
+
+    return (int)count;
+}
+
+int HardwareSerial::read()
+{
+    if (_rx.empty() || _rx.front().time > host_time_us)
+    {
+        return -1;
+    }
+
+    uint8_t value = _rx.front().value;
+    _rx.pop_front();
+
+    return value;
+}
+
+int HardwareSerial::peek()
+{
+    if (_rx.empty() || _rx.front().time > host_time_us)
+    {
+        return -1;
+    }
+
+    return _rx.front().value;
+}
+
+void HardwareSerial::respond(const uint8_t *data, size_t length, uint32_t delay_us)
+{
+    uint64_t time = host_time_us + delay_us;
+
+    for (size_t i = 0; i < length; i++)
+    {
+        Pending pending = {time, data[i]};
+        _rx.push_back(pending);
+    }
+}
+
+void TwoWire::beginTransmission(uint8_t address)
+{
+    _address = address;
+    _tx_length = 0;
+    _tx_overflow = false;
+}
+
+size_t TwoWire::write(uint8_t value)
+{
+    if (_tx_length >= sizeof(_tx))
+    {
+        _tx_overflow = true;
+        return 0;
+    }
+
+    _tx[_tx_length++] = value;
+    return 1;
+}
+
+size_t TwoWire::write(const uint8_t *buffer, size_t size)
+{
+    size_t written = 0;
+
+    while (size-- > 0 && write(*buffer++) == 1)
+    {
+        written++;
+    }
+
+    return written;
+}
+
+uint8_t TwoWire::endTransmission(bool stop)
+{
+    (void)stop;
+    _transmissions++;
+
+    if (_tx_overflow)
+    {
+        return 1; // Data too long for the buffer
+    }
+
+    return _device == NULL ? 2 : _device->transmission(_address, _tx, _tx_length);
+}
+
+uint8_t TwoWire::requestFrom(uint8_t address, uint8_t quantity)
+{
+    _rx_position = 0;
+    _rx_length = 0;
+
+    if (quantity > sizeof(_rx))
+    {
+        quantity = sizeof(_rx);
+    }
+
+    if (_device != NULL)
+    {
+        _rx_length = _device->request(address, _rx, quantity);
+    }
+
+    return (uint8_t)_rx_length;
+}
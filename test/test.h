@@ -0,0 +1,41 @@
+/**
+ * SPS30 - Host test helpers
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#ifndef SPS30_TEST_H
+#define SPS30_TEST_H
+
+#include <stdio.h>
+
+static int test_checks = 0;
+static int test_failures = 0;
+
+// CHECK reports a failed condition and carries on, so one run shows every failure.
+#define CHECK(condition)                                                        \
+    do                                                                          \
+    {                                                                           \
+        test_checks++;                                                          \
+        if (!(condition))                                                       \
+        {                                                                       \
+            printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++;                                                    \
+        }                                                                       \
+    } while (0)
+
+// test_result prints the summary, main returns it.
+static inline int test_result(const char *name)
+{
+    printf("%s: %d checks, %d failed\n", name, test_checks, test_failures);
+    return test_failures == 0 ? 0 : 1;
+}
+
+#endif
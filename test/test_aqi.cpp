@@ -0,0 +1,142 @@
+/**
+ * SPS30 - Air quality metrics test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_aqi.h"
+#include "test.h"
+
+#define MINUTE_MS 60000UL
+
+static Measurements measurement(float pm2, float pm10)
+{
+    Measurements v;
+
+    memset(&v, 0, sizeof(v));
+    v.MassPM2 = pm2;
+    v.MassPM10 = pm10;
+    v.PartSize = 0.5;
+
+    return v;
+}
+
+static uint16_t us_aqi(float pm2, float pm10)
+{
+    SPS30_air_quality aq;
+    Measurements v = measurement(pm2, pm10);
+
+    aq.add(&v, 1000);
+    return aq.get_us_aqi();
+}
+
+static uint8_t caqi(float pm2, float pm10)
+{
+    SPS30_air_quality aq;
+    Measurements v = measurement(pm2, pm10);
+
+    aq.add(&v, 1000);
+    return aq.get_caqi();
+}
+
+// The US EPA AQI is interpolated between the breakpoints, PM2.5 is truncated to 0.1 and PM10 to 1 μg/m3.
+static void test_us_aqi()
+{
+    CHECK(us_aqi(0, 0) == 0);
+    CHECK(us_aqi(9.0, 0) == 50);
+    CHECK(us_aqi(9.05, 0) == 50); // Truncated into the first row
+    CHECK(us_aqi(12.0, 0) == 56);
+    CHECK(us_aqi(35.4, 0) == 100);
+    CHECK(us_aqi(35.5, 0) == 101);
+    CHECK(us_aqi(55.5, 0) == 151);
+    CHECK(us_aqi(325.4, 0) == 500);
+    CHECK(us_aqi(1000, 0) == 500); // Capped at the top of the table
+
+    CHECK(us_aqi(0, 54.9) == 50);
+    CHECK(us_aqi(0, 155) == 101);
+    CHECK(us_aqi(12.0, 155) == 101); // The worse of both
+}
+
+// The EU CAQI grid is linear within a class, 100 means 100 or more.
+static void test_caqi()
+{
+    CHECK(caqi(0, 0) == 0);
+    CHECK(caqi(15, 0) == 25);
+    CHECK(caqi(22.5, 0) == 38);
+    CHECK(caqi(110, 0) == 100);
+    CHECK(caqi(0, 37.5) == 38);
+    CHECK(caqi(0, 500) == 100);
+}
+
+// The hour forgets what is older than its 12 buckets, the day keeps it.
+static void test_rolling_averages()
+{
+    SPS30_air_quality aq;
+    Measurements v;
+
+    v = measurement(10, 20);
+    aq.add(&v, 0);
+    v = measurement(20, 40);
+    aq.add(&v, 30 * MINUTE_MS);
+
+    CHECK(aq.get_average(AQ_PM2, AQ_HOUR) == 15);
+    CHECK(aq.get_average(AQ_PM10, AQ_HOUR) == 30);
+    CHECK(fabs(aq.get_pm_ratio() - 0.5) < 0.001);
+
+    v = measurement(30, 60);
+    aq.add(&v, 65 * MINUTE_MS);
+
+    CHECK(aq.get_average(AQ_PM2, AQ_HOUR) == 25);
+    CHECK(aq.get_average(AQ_PM2, AQ_DAY) == 20);
+
+    v = measurement(40, 80);
+    aq.add(&v, 25 * 60 * MINUTE_MS);
+
+    CHECK(aq.get_average(AQ_PM2, AQ_HOUR) == 40);
+    CHECK(aq.get_average(AQ_PM2, AQ_DAY) == 40);
+}
+
+// The samples before millis() wraps around stay in the averages.
+static void test_wrap()
+{
+    SPS30_air_quality aq;
+    Measurements v = measurement(10, 10);
+    uint32_t now = UINT32_MAX - 20 * MINUTE_MS + 1;
+
+    for (int i = 0; i < 20; i++, now += MINUTE_MS)
+    {
+        aq.add(&v, now);
+    }
+
+    v = measurement(40, 40);
+    for (int i = 0; i < 10; i++, now += MINUTE_MS)
+    {
+        aq.add(&v, now);
+    }
+
+    CHECK(aq.get_average(AQ_PM2, AQ_HOUR) == 20);
+    CHECK(aq.get_average(AQ_PM2, AQ_DAY) == 20);
+
+    now += 60 * MINUTE_MS; // The hour moves on past the wrap.
+    aq.add(&v, now);
+
+    CHECK(aq.get_average(AQ_PM2, AQ_HOUR) == 40);
+    CHECK(fabs(aq.get_average(AQ_PM2, AQ_DAY) - 640.0 / 31) < 0.001);
+}
+
+int main()
+{
+    test_us_aqi();
+    test_caqi();
+    test_rolling_averages();
+    test_wrap();
+
+    return test_result("test_aqi");
+}
@@ -0,0 +1,95 @@
+/**
+ * SPS30 - Averaging test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30_average.h"
+#include "test.h"
+
+// A sensor that wasn't started is started, instead of waiting for data ready until the time out.
+static void test_not_started()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_average average(&sps30);
+    float values[10] = {1, 2, 3, 4, 5, 6, 7, 8, 9, 10};
+    Measurements v;
+
+    sensor.attach(&Wire);
+    sensor.set_values(values);
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(!sps30.is_started());
+
+    SPS30_status status = average.get_values(&v, 3);
+
+    CHECK(status.ok());
+    CHECK(sps30.is_started());
+    CHECK(sensor.value_reads == 3);
+    CHECK(v.MassPM2 == 2);
+}
+
+// More than 255 samples are averaged correctly.
+static void test_many_samples()
+{
+    SPS30_average average;
+    Measurements v;
+    float confidence;
+
+    for (int i = 0; i < 1000; i++)
+    {
+        memset(&v, 0, sizeof(v));
+        v.MassPM1 = i % 2 ? 20 : 10;
+        average.add(&v);
+    }
+
+    average.result(&v, &confidence);
+
+    CHECK(average.count() == 1000);
+    CHECK(fabs(v.MassPM1 - 15) < 0.001);
+    CHECK(confidence == 1);
+}
+
+// After identical samples the MAD is 0, a small change still passes the Hampel filter and a spike doesn't.
+static void test_hampel_flat()
+{
+    SPS30_average average;
+    Measurements v;
+    float confidence;
+
+    CHECK(average.set_filter(FILTER_HAMPEL));
+    memset(&v, 0, sizeof(v));
+
+    for (int i = 0; i < AVERAGE_WINDOW; i++)
+    {
+        v.MassPM1 = 10;
+        CHECK(average.add(&v));
+    }
+
+    v.MassPM1 = 11;
+    CHECK(average.add(&v));
+
+    v.MassPM1 = 100;
+    CHECK(!average.add(&v));
+
+    average.result(&v, &confidence);
+    CHECK(fabs(v.MassPM1 - 71.0 / 7) < 0.001); // The spike is replaced by the median.
+    CHECK(fabs(confidence - (7.0 * AVERAGE_CHANNELS - 1) / (7 * AVERAGE_CHANNELS)) < 0.001);
+}
+
+int main()
+{
+    test_not_started();
+    test_many_samples();
+    test_hampel_flat();
+
+    return test_result("test_average");
+}
@@ -0,0 +1,151 @@
+/**
+ * SPS30 - Change detection test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_change.h"
+#include "test.h"
+
+struct Reports
+{
+    uint32_t count = 0;
+    uint8_t reasons = CHANGE_NONE;
+    float pm2 = 0;
+};
+
+static void report(const Measurements *v, uint8_t reasons, void *context)
+{
+    Reports *reports = (Reports *)context;
+
+    reports->count++;
+    reports->reasons = reasons;
+    reports->pm2 = v->MassPM2;
+}
+
+static Measurements measurement(float pm2)
+{
+    Measurements v;
+
+    memset(&v, 0, sizeof(v));
+    v.MassPM2 = pm2;
+
+    return v;
+}
+
+// Only a value outside the band around the last reported one is reported, the band is the larger of both.
+static void test_deadband()
+{
+    Reports reports;
+    SPS30_change change(report, &reports);
+    Measurements v;
+
+    CHECK(change.set_deadband(MassPM2, 2, 0.1));
+    CHECK(!change.set_deadband(PartSize + 1, 2));
+
+    v = measurement(10);
+    CHECK(change.update(&v, 0) == CHANGE_FIRST);
+
+    v = measurement(11.9);
+    CHECK(change.update(&v, 1000) == CHANGE_NONE);
+    v = measurement(8.1);
+    CHECK(change.update(&v, 2000) == CHANGE_NONE);
+
+    v = measurement(12.1);
+    CHECK(change.update(&v, 3000) == CHANGE_DEADBAND);
+    CHECK(reports.count == 2 && reports.pm2 == 12.1f);
+
+    // Around 100 the relative band of 10 is the larger one.
+    v = measurement(100);
+    change.update(&v, 4000);
+    v = measurement(109);
+    CHECK(change.update(&v, 5000) == CHANGE_NONE);
+    v = measurement(111);
+    CHECK(change.update(&v, 6000) == CHANGE_DEADBAND);
+
+    // Creeping by less than the band per sample is reported once it adds up.
+    uint32_t before = reports.count;
+    for (int i = 1; i <= 20; i++)
+    {
+        v = measurement(111 + i);
+        change.update(&v, 6000 + i * 1000);
+    }
+    CHECK(reports.count == before + 1);
+
+    CHECK(change.get_sample_count() == 27);
+    CHECK(change.get_report_count() == reports.count);
+}
+
+// A fast change is reported even within the band, the rate is per second between two samples.
+static void test_rate()
+{
+    Reports reports;
+    SPS30_change change(report, &reports);
+    Measurements v;
+
+    change.set_deadband(MassPM2, 50);
+    change.set_rate(MassPM2, 5);
+
+    v = measurement(10);
+    change.update(&v, 0);
+    v = measurement(14);
+    CHECK(change.update(&v, 1000) == CHANGE_NONE);
+    v = measurement(20);
+    CHECK(change.update(&v, 2000) == CHANGE_RATE);
+    v = measurement(29);
+    CHECK(change.update(&v, 4000) == CHANGE_NONE); // 4.5 per second
+}
+
+// Without any change a heartbeat is reported after the max silence.
+static void test_heartbeat()
+{
+    Reports reports;
+    SPS30_change change(report, &reports);
+    Measurements v = measurement(10);
+
+    change.set_deadband(MassPM2, 2);
+    change.set_heartbeat(60000);
+
+    change.update(&v, 0);
+    for (uint32_t now = 1000; now < 60000; now += 1000)
+    {
+        CHECK(change.update(&v, now) == CHANGE_NONE);
+    }
+    CHECK(change.update(&v, 60000) == CHANGE_HEARTBEAT);
+    CHECK(reports.reasons == CHANGE_HEARTBEAT);
+    CHECK(change.update(&v, 61000) == CHANGE_NONE);
+}
+
+// Channels without a band report every change.
+static void test_no_band()
+{
+    SPS30_change change;
+    Measurements v = measurement(10);
+
+    change.set_deadband(MassPM2, 2);
+    change.update(&v, 0);
+
+    v.NumPM0 = 0.01;
+    CHECK(change.update(&v, 1000) == CHANGE_DEADBAND);
+
+    change.clear();
+    CHECK(change.update(&v, 2000) == CHANGE_FIRST);
+    CHECK(change.get_report_count() == 1);
+}
+
+int main()
+{
+    test_deadband();
+    test_rate();
+    test_heartbeat();
+    test_no_band();
+
+    return test_result("test_change");
+}
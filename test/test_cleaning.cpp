@@ -0,0 +1,130 @@
+/**
+ * SPS30 - Fan cleaning test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Runs the cleaning schedule on the simulated clock: a cleaning waits
+ * for a quiet moment, is forced after the max delay, and the samples
+ * in the cleaning window are masked without using the bus.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30_cleaning.h"
+#include "test.h"
+
+static void set_pm10(SimSPS30 *sensor, float pm10)
+{
+    float values[10] = {0, 0, 0, pm10, 0, 0, 0, 0, 0, 0};
+    sensor->set_values(values);
+}
+
+// run reads a sample every second for the given time and counts the masked samples.
+static uint32_t run(SPS30_cleaning *cleaning, SimSPS30 *sensor, uint32_t seconds, uint32_t *masked_reads)
+{
+    uint32_t masked = 0;
+
+    for (uint32_t s = 0; s < seconds; s++)
+    {
+        Measurements v;
+        uint32_t reads = sensor->value_reads;
+
+        host_time_us += 1000000;
+        boolean window = sensor->cleaning(); // A cleaning started by this call comes after the read.
+        SPS30_status status = cleaning->get_values(&v, millis());
+
+        if (status.error == SPS30_ERROR_CLEANING)
+        {
+            masked++;
+            if (sensor->value_reads != reads)
+            {
+                (*masked_reads)++;
+            }
+        }
+        else
+        {
+            CHECK(status.ok());
+            CHECK(!window); // No valid sample may come from the cleaning window.
+        }
+    }
+
+    return masked;
+}
+
+// A due cleaning waits for a quiet sample, the window is masked.
+static void test_quiet_moment()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_cleaning cleaning(&sps30);
+    uint32_t masked_reads = 0;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    CHECK(cleaning.begin(60, 10.0, 3600, millis()).ok());
+    CHECK(sensor.auto_clean_interval == 0); // The schedule replaces the auto cleaning.
+
+    set_pm10(&sensor, 50);
+    CHECK(run(&cleaning, &sensor, 120, &masked_reads) == 0); // Due after 60 s, but never quiet.
+    CHECK(sensor.cleanings == 0);
+    CHECK(cleaning.time_to_cleaning(millis()) == 0);
+
+    set_pm10(&sensor, 5);
+    uint32_t masked = run(&cleaning, &sensor, 20, &masked_reads);
+
+    CHECK(sensor.cleanings == 1);
+    CHECK(masked >= (CLEANING_DURATION_MS + CLEANING_SETTLE_MS) / 1000 - 1);
+    CHECK(masked <= (CLEANING_DURATION_MS + CLEANING_SETTLE_MS) / 1000);
+    CHECK(masked_reads == 0);
+    CHECK(!cleaning.cleaning(millis()));
+    CHECK(cleaning.time_to_cleaning(millis()) > 40000);
+}
+
+// Without a quiet moment the cleaning is forced after the max delay.
+static void test_max_delay()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_cleaning cleaning(&sps30);
+    uint32_t masked_reads = 0;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    CHECK(cleaning.begin(60, 10.0, 30, millis()).ok());
+
+    set_pm10(&sensor, 50);
+    run(&cleaning, &sensor, 89, &masked_reads);
+    CHECK(sensor.cleanings == 0);
+
+    run(&cleaning, &sensor, 2, &masked_reads);
+    CHECK(sensor.cleanings == 1);
+    CHECK(masked_reads == 0);
+}
+
+// Intervals that don't fit in ms are refused.
+static void test_parameters()
+{
+    SPS30 sps30;
+    SPS30_cleaning cleaning(&sps30);
+
+    CHECK(cleaning.begin(0).error == SPS30_ERROR_PARAMETER);
+    CHECK(cleaning.begin(5000000).error == SPS30_ERROR_PARAMETER);
+}
+
+int main()
+{
+    test_quiet_moment();
+    test_max_delay();
+    test_parameters();
+
+    return test_result("test_cleaning");
+}
@@ -0,0 +1,158 @@
+/**
+ * SPS30 - Measured value decoding test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Fuzzes the one pass decode of the measured values against a plain
+ * reference decoder, over UART and I2C, with random bit patterns
+ * (NaN's and denormals included), and times both decoders.
+ *********************************************************************
+*/
+
+#include <chrono>
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+#define ROUNDS 2000
+
+// reference_decode assembles the big endian floats byte by byte, the way the datasheet describes them.
+static void reference_decode(const uint8_t *buffer, uint8_t bytes, Measurements *v)
+{
+    float *out = &v->MassPM1;
+
+    memset(v, 0, sizeof(*v));
+
+    for (uint8_t i = 0; i < bytes / 4; i++)
+    {
+        uint32_t bits = 0;
+
+        for (uint8_t b = 0; b < 4; b++)
+        {
+            bits = bits << 8 | buffer[i * 4 + b];
+        }
+
+        memcpy(&out[i], &bits, sizeof(bits));
+    }
+}
+
+static void random_values(SimSPS30 *sensor)
+{
+    for (size_t i = 0; i < sizeof(sensor->values); i++)
+    {
+        sensor->values[i] = rand() & 0xFF;
+    }
+
+    // Now and then the bytes the SHDLC has to stuff.
+    if (rand() % 4 == 0)
+    {
+        const uint8_t special[] = {0x7E, 0x7D, 0x11, 0x13};
+        sensor->values[rand() % sizeof(sensor->values)] = special[rand() % 4];
+    }
+}
+
+static void fuzz(SPS30 *sps30, SimSPS30 *sensor, uint8_t bytes, const char *name)
+{
+    int mismatches = 0;
+
+    for (int round = 0; round < ROUNDS; round++)
+    {
+        Measurements expected;
+        Measurements v;
+
+        random_values(sensor);
+        reference_decode(sensor->values, bytes, &expected);
+        memset(&v, 0xA5, sizeof(v));
+
+        host_time_us += SIM_SAMPLE_MS * 1000;
+        SPS30_status status = sps30->get_values(&v);
+
+        CHECK(status.ok());
+        if (memcmp(&v, &expected, sizeof(v)) != 0) // Bitwise, NaN != NaN
+        {
+            mismatches++;
+        }
+    }
+
+    printf("%s: %d rounds, %d mismatches\n", name, ROUNDS, mismatches);
+    CHECK(mismatches == 0);
+}
+
+static void benchmark()
+{
+    uint8_t buffer[40];
+    Measurements v;
+    volatile uint32_t sink = 0;
+    const int loops = 1000000;
+
+    for (size_t i = 0; i < sizeof(buffer); i++)
+    {
+        buffer[i] = rand() & 0xFF;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < loops; i++)
+    {
+        buffer[0] = i;
+        reference_decode(buffer, sizeof(buffer), &v);
+        sink += *(volatile uint32_t *)&v;
+    }
+    auto middle = std::chrono::steady_clock::now();
+
+    // The library decodes in the same way as decode_measurements: one swapped load per value.
+    for (int i = 0; i < loops; i++)
+    {
+        buffer[0] = i;
+        uint8_t *out = (uint8_t *)&v;
+        for (uint8_t n = 0; n < 10; n++)
+        {
+            uint32_t value;
+            memcpy(&value, &buffer[n * 4], sizeof(value));
+            value = __builtin_bswap32(value);
+            memcpy(&out[n * 4], &value, sizeof(value));
+        }
+        sink += *(volatile uint32_t *)&v;
+    }
+    auto end = std::chrono::steady_clock::now();
+
+    printf("decode: reference %.1f ns, byte swap %.1f ns per message\n",
+           std::chrono::duration<double, std::nano>(middle - start).count() / loops,
+           std::chrono::duration<double, std::nano>(end - middle).count() / loops);
+}
+
+int main()
+{
+    srand(29);
+
+    {
+        SimSPS30 sensor;
+        SPS30 sps30;
+
+        sensor.attach(&Serial1);
+        CHECK(sps30.begin(&Serial1).ok());
+        CHECK(sps30.start().ok());
+        fuzz(&sps30, &sensor, 40, "uart");
+    }
+
+    {
+        SimSPS30 sensor;
+        SPS30 sps30;
+
+        sensor.attach(&Wire);
+        CHECK(sps30.begin(&Wire).ok());
+        CHECK(sps30.start().ok());
+        fuzz(&sps30, &sensor, I2C_MEASURED_VALUE_LENGTH, "i2c");
+    }
+
+    benchmark();
+
+    return test_result("test_decode");
+}
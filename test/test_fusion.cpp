@@ -0,0 +1,99 @@
+/**
+ * SPS30 - Sensor fusion test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30_fusion.h"
+#include "test.h"
+
+#define SPEED_WARNING (1UL << 21) // Bits of the status register
+#define LASER_FAULT (1UL << 5)
+
+// Two units on their own serial port, the status register is read with every measurement.
+struct Units
+{
+    SimSPS30 sensors[2];
+    SPS30 sps30[2];
+    SPS30_fusion fusion;
+
+    Units()
+    {
+        float values[2][10] = {{10, 20, 30, 40, 1, 2, 3, 4, 5, 0.5}, {12, 22, 32, 42, 1, 2, 3, 4, 5, 0.5}};
+        HardwareSerial *ports[2] = {&Serial, &Serial1};
+
+        for (int i = 0; i < 2; i++)
+        {
+            sensors[i].attach(ports[i]);
+            sensors[i].set_values(values[i]);
+            CHECK(sps30[i].begin(ports[i]).ok());
+            CHECK(sps30[i].start().ok());
+            sps30[i].set_health_ratio(1);
+            CHECK(fusion.add_sensor(&sps30[i]));
+        }
+    }
+
+    SPS30_status read(Measurements *v)
+    {
+        host_time_us += 1100000;
+        return fusion.get_values(v);
+    }
+};
+
+// A fan speed warning is reported, but the unit is still combined.
+static void test_speed_warning()
+{
+    Units units;
+    Measurements v;
+
+    units.sensors[0].status_register = SPEED_WARNING;
+    CHECK(units.read(&v).ok());
+    CHECK(units.fusion.get_faults(0) == FUSION_SPEED);
+    CHECK(v.MassPM1 == 11); // The median of both units
+}
+
+// Units with a laser fault are left out, without any usable unit the result says so.
+static void test_no_usable_sensor()
+{
+    Units units;
+    Measurements v;
+
+    units.sensors[0].status_register = LASER_FAULT;
+    CHECK(units.read(&v).ok());
+    CHECK(v.MassPM1 == 12);
+
+    units.sensors[1].status_register = LASER_FAULT;
+    SPS30_status status = units.read(&v);
+    CHECK(status.error == SPS30_ERROR_NO_SENSOR);
+    CHECK(units.fusion.get_healthy_count() == 0);
+}
+
+// When no unit answers the read error is returned.
+static void test_no_answer()
+{
+    Units units;
+    Measurements v;
+
+    units.sensors[0].drop = 10;
+    units.sensors[1].drop = 10;
+    CHECK(units.read(&v).error == SPS30_ERROR_TIMEOUT);
+    CHECK(units.fusion.get_faults(0) == FUSION_COMMS);
+    CHECK(units.fusion.get_faults(7) == FUSION_OK);
+}
+
+int main()
+{
+    test_speed_warning();
+    test_no_usable_sensor();
+    test_no_answer();
+
+    return test_result("test_fusion");
+}
@@ -0,0 +1,101 @@
+/**
+ * SPS30 - Response latency test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+#define READS 20
+
+// Once the latency is learned an I2C read waits for the sensor, not the fixed RX_DELAY_MS.
+static void test_learned_wait()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(sps30.start().ok());
+
+    uint64_t start = 0;
+
+    for (int i = 0; i < READS; i++)
+    {
+        if (i == READS / 2) // The first reads learn the latency.
+        {
+            start = host_time_us;
+        }
+        CHECK(sps30.read_data_ready().ok());
+    }
+
+    double ms = (host_time_us - start) / 1000.0 / (READS - READS / 2);
+    printf("I2C read data ready: %.2f ms per read, %d ms with the fixed wait\n", ms, RX_DELAY_MS);
+
+    CHECK(ms < RX_DELAY_MS / 2);
+    CHECK(sps30.get_retry_count() == 0);
+}
+
+// Answers that are there at once don't wear the latency down below the floor, a slower one later still fits the time out.
+static void test_floor()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Wire);
+    sensor.latency_us = 0;
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(sps30.start().ok());
+
+    for (int i = 0; i < READS; i++)
+    {
+        CHECK(sps30.read_data_ready().ok());
+    }
+
+    CHECK(sps30.get_response_latency(READ_DATA_READY) == LATENCY_MIN_MS);
+
+    sensor.latency_us = 4 * LATENCY_MIN_MS * 1000;
+    CHECK(sps30.read_data_ready().ok());
+    CHECK(sps30.get_retry_count() == 0);
+}
+
+// Over UART the floor is the execution time of the command.
+static void test_floor_uart()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Serial1);
+    sensor.latency_us = 0;
+    CHECK(sps30.begin(&Serial1).ok());
+
+    for (int i = 0; i < READS; i++)
+    {
+        CHECK(sps30.start().ok());
+        CHECK(sps30.get_values(&v).ok());
+    }
+
+    CHECK(sps30.get_response_latency(START_MEASUREMENT) == 20);
+    CHECK(sps30.get_response_latency(READ_MEASURED_VALUE) == LATENCY_MIN_MS);
+
+    Serial1.attach(NULL);
+}
+
+int main()
+{
+    test_learned_wait();
+    test_floor();
+    test_floor_uart();
+
+    return test_result("test_latency");
+}
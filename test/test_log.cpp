@@ -0,0 +1,142 @@
+/**
+ * SPS30 - Sample log test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include <unistd.h>
+
+#include "sps30_log.h"
+#include "test.h"
+
+#define SEGMENTS 4
+#define RECORDS 4 // Records per segment
+#define SEGMENT_SIZE (sizeof(LogSegmentHeader) + RECORDS * sizeof(LogRecord))
+
+static Measurements measurement(uint32_t n)
+{
+    Measurements v;
+
+    memset(&v, 0, sizeof(v));
+    v.MassPM2 = n;
+    return v;
+}
+
+// read_all reads the log from the oldest record and checks that the sequence numbers follow each other.
+static uint32_t read_all(SPS30_log *log, uint32_t first)
+{
+    uint32_t position = log->oldest();
+    uint32_t count = 0;
+    LogRecord record;
+
+    while (log->read(&position, &record))
+    {
+        CHECK(record.sequence == first + count);
+        CHECK(record.values.MassPM2 == first + count);
+        count++;
+    }
+
+    CHECK(position == log->end());
+    return count;
+}
+
+// A log that was just formatted has erased segments next to segment 0, they are not part of the log.
+static void test_reopen_fresh()
+{
+    FILE *file = tmpfile();
+    SPS30_file_device device(file, SEGMENT_SIZE, SEGMENTS);
+    SPS30_log log;
+
+    CHECK(log.begin(&device));
+    CHECK(log.clear());
+    for (uint32_t n = 0; n < 3; n++)
+    {
+        Measurements v = measurement(n);
+        CHECK(log.append(&v, 100 + n));
+    }
+
+    SPS30_log reopened;
+
+    CHECK(reopened.begin(&device));
+    CHECK(reopened.oldest() == log.oldest());
+    CHECK(reopened.end() == 3);
+    CHECK(read_all(&reopened, 0) == 3);
+
+    fclose(file);
+}
+
+// After the segments went round a few times only the newest ones are in the log, before and after reopening.
+static void test_reopen_wrapped()
+{
+    FILE *file = tmpfile();
+    SPS30_file_device device(file, SEGMENT_SIZE, SEGMENTS);
+    SPS30_log log;
+    uint32_t appended = 3 * SEGMENTS * RECORDS + 2;
+
+    CHECK(log.begin(&device));
+    CHECK(log.clear());
+    for (uint32_t n = 0; n < appended; n++)
+    {
+        Measurements v = measurement(n);
+        CHECK(log.append(&v, 100 + n));
+    }
+
+    uint32_t kept = (SEGMENTS - 1) * RECORDS + 2; // The head holds 2, the rest of the segments are full
+    CHECK(read_all(&log, appended - kept) == kept);
+
+    SPS30_log reopened;
+
+    CHECK(reopened.begin(&device));
+    CHECK(reopened.oldest() == log.oldest());
+    CHECK(reopened.end() == log.end());
+    CHECK(read_all(&reopened, appended - kept) == kept);
+    CHECK(reopened.seek(100 + appended - 1) != reopened.end());
+
+    Measurements v = measurement(appended);
+    CHECK(reopened.append(&v, 100 + appended));
+    CHECK(read_all(&reopened, appended - kept) == kept + 1);
+
+    fclose(file);
+}
+
+// A position in a segment that isn't part of the log restarts at the oldest record.
+static void test_empty_segment_position()
+{
+    FILE *file = tmpfile();
+    SPS30_file_device device(file, SEGMENT_SIZE, SEGMENTS);
+    SPS30_log log;
+
+    CHECK(log.begin(&device));
+    CHECK(log.clear());
+    for (uint32_t n = 0; n < RECORDS + 1; n++)
+    {
+        Measurements v = measurement(n);
+        CHECK(log.append(&v, 100 + n));
+    }
+
+    uint32_t position = 3 * RECORDS; // Segment 3 is still erased.
+    LogRecord record;
+
+    CHECK(log.read(&position, &record));
+    CHECK(record.sequence == 0);
+
+    fclose(file);
+}
+
+int main()
+{
+    alarm(10); // A read that loops forever fails the test instead of hanging it.
+
+    test_reopen_fresh();
+    test_reopen_wrapped();
+    test_empty_segment_position();
+
+    return test_result("test_log");
+}
@@ -0,0 +1,165 @@
+/**
+ * SPS30 - Multiplexer test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Two multiplexers on one bus, with a simulated sensor behind some of
+ * their channels. All sensors have the same address, a transfer that
+ * reaches more than one of them is a conflict and is not acknowledged.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+#define MUX_ADDRESS 0x70 // Of the first multiplexer, the second one is at 0x71
+
+class Bus : public HostWireDevice
+{
+public:
+    uint8_t channels[2] = {0, 0}; // Channels switched on per multiplexer
+    uint32_t writes[2] = {0, 0};  // Writes per multiplexer
+    uint32_t conflicts = 0;       // Transfers that reached more than one sensor
+    SimSPS30 *sensors[2][8] = {};
+
+    uint8_t transmission(uint8_t address, const uint8_t *data, size_t length)
+    {
+        if ((address & ~1) == MUX_ADDRESS && length == 1)
+        {
+            channels[address & 1] = data[0];
+            writes[address & 1]++;
+            return 0;
+        }
+
+        SimSPS30 *sensor = connected();
+        return sensor == NULL ? 2 : sensor->transmission(address, data, length);
+    }
+
+    size_t request(uint8_t address, uint8_t *data, size_t length)
+    {
+        SimSPS30 *sensor = connected();
+        return sensor == NULL ? 0 : sensor->request(address, data, length);
+    }
+
+private:
+    // connected returns the only sensor on a switched on channel, NULL when there is none or more than one.
+    SimSPS30 *connected()
+    {
+        SimSPS30 *sensor = NULL;
+        int count = 0;
+
+        for (int m = 0; m < 2; m++)
+        {
+            for (int c = 0; c < 8; c++)
+            {
+                if ((channels[m] & 1 << c) && sensors[m][c] != NULL)
+                {
+                    sensor = sensors[m][c];
+                    count++;
+                }
+            }
+        }
+
+        conflicts += count > 1;
+        return count == 1 ? sensor : NULL;
+    }
+};
+
+// Switching to a sensor behind the other multiplexer switches the first one off, there is never a conflict.
+static void test_two_muxes()
+{
+    Bus bus;
+    SimSPS30 sensor_a, sensor_b;
+    SPS30_mux mux_a(&Wire, MUX_ADDRESS), mux_b(&Wire, MUX_ADDRESS + 1);
+    SPS30 sps30_a, sps30_b;
+
+    bus.sensors[0][0] = &sensor_a;
+    bus.sensors[1][3] = &sensor_b;
+    Wire.attach(&bus);
+
+    CHECK(sps30_a.begin(&mux_a, 0).ok());
+    CHECK(sps30_b.begin(&mux_b, 3).ok());
+    CHECK(bus.channels[0] == 0 && bus.channels[1] == 1 << 3);
+
+    bus.writes[0] = bus.writes[1] = 0;
+    sensor_a.commands.clear();
+    sensor_b.commands.clear();
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(sps30_a.read_data_ready().ok());
+        CHECK(sps30_b.read_data_ready().ok());
+    }
+
+    CHECK(bus.conflicts == 0);
+    CHECK(sensor_a.commands.size() == 3 && sensor_b.commands.size() == 3);
+    CHECK(bus.writes[0] == 6 && bus.writes[1] == 6); // Switched on and off for every read
+    CHECK(bus.channels[0] == 0 && bus.channels[1] == 1 << 3);
+
+    Wire.attach(NULL);
+}
+
+// Reads of the selected sensor, or of another sensor behind the same multiplexer, write no more than needed.
+static void test_cached()
+{
+    Bus bus;
+    SimSPS30 sensor_1, sensor_2;
+    SPS30_mux mux(&Wire, MUX_ADDRESS);
+    SPS30 sps30_1, sps30_2;
+
+    bus.sensors[0][1] = &sensor_1;
+    bus.sensors[0][2] = &sensor_2;
+    Wire.attach(&bus);
+
+    CHECK(sps30_1.begin(&mux, 1).ok());
+    CHECK(sps30_2.begin(&mux, 2).ok());
+    bus.writes[0] = 0;
+
+    for (int i = 0; i < 3; i++)
+    {
+        CHECK(sps30_2.read_data_ready().ok());
+    }
+    CHECK(bus.writes[0] == 0);
+
+    CHECK(sps30_1.read_data_ready().ok());
+    CHECK(bus.writes[0] == 1 && bus.channels[0] == 1 << 1);
+    CHECK(mux.get_switch_count() == 3);
+    CHECK(bus.conflicts == 0);
+
+    Wire.attach(NULL);
+}
+
+// order puts the sensors without a multiplexer first, then by multiplexer and channel.
+static void test_order()
+{
+    SPS30_mux mux(&Wire, MUX_ADDRESS);
+    SPS30 direct, first, second;
+    SPS30 *sensors[] = {&second, &direct, &first};
+
+    Wire.attach(NULL); // Nothing answers, begin only sets up the sensors.
+    direct.begin(&Wire);
+    first.begin(&mux, 1);
+    second.begin(&mux, 4);
+
+    CHECK(first.get_mux() == &mux && first.get_mux_channel() == 1);
+
+    SPS30_mux::order(sensors, 3);
+    CHECK(sensors[0] == &direct && sensors[1] == &first && sensors[2] == &second);
+}
+
+int main()
+{
+    test_two_muxes();
+    test_cached();
+    test_order();
+
+    return test_result("test_mux");
+}
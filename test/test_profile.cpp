@@ -0,0 +1,157 @@
+/**
+ * SPS30 - Transaction profiling test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Built with SPS30_PROFILING, the profile clock is the micros() of
+ * the host stub. Checks that every phase of a transaction lands once
+ * in its histogram, in the bucket of the time it took.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+#ifndef SPS30_PROFILING
+#error "test_profile has to be built with SPS30_PROFILING"
+#endif
+
+#define READS 50
+
+static uint32_t histogram_count(SPS30 *sps30, uint8_t phase)
+{
+    const uint16_t *histogram = sps30->get_profile_histogram(phase);
+    uint32_t count = 0;
+
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+    {
+        count += histogram[b];
+    }
+
+    return count;
+}
+
+// bucket_of returns the bucket that holds the given number of ticks.
+static uint8_t bucket_of(uint32_t ticks)
+{
+    uint8_t bucket = 0;
+
+    while ((ticks >>= 1) != 0 && bucket < PROFILE_BUCKETS - 1)
+    {
+        bucket++;
+    }
+
+    return bucket;
+}
+
+static void test_uart()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Serial1);
+    sensor.latency_us = 3000;
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    sps30.clear_profile();
+
+    for (int i = 0; i < READS; i++)
+    {
+        host_time_us += 1000000;
+        CHECK(sps30.get_values(&v).ok());
+    }
+
+    for (uint8_t phase = 0; phase < PROFILE_PHASES; phase++)
+    {
+        CHECK(histogram_count(&sps30, phase) == READS);
+    }
+
+    // The wait is the latency of the sensor, the other phases are short on the host.
+    const uint16_t *wait = sps30.get_profile_histogram(PROFILE_WAIT);
+    uint32_t average = sps30.get_profile_ticks(PROFILE_WAIT) / READS;
+
+    CHECK(average >= 3000 && average < 3500);
+    CHECK(wait[bucket_of(average)] + wait[bucket_of(average) + 1] == READS);
+    CHECK(sps30.get_profile_ticks(PROFILE_DECODE) / READS < 100);
+
+    CHECK(sps30.get_profile_histogram(PROFILE_PHASES) == NULL);
+    CHECK(sps30.get_profile_ticks(PROFILE_PHASES) == 0);
+
+    sps30.clear_profile();
+    for (uint8_t phase = 0; phase < PROFILE_PHASES; phase++)
+    {
+        CHECK(histogram_count(&sps30, phase) == 0);
+        CHECK(sps30.get_profile_ticks(phase) == 0);
+    }
+}
+
+// I2C has no separate CRC phase, the CRC's are checked while receiving.
+static void test_i2c()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(sps30.start().ok());
+    sps30.clear_profile();
+
+    for (int i = 0; i < READS; i++)
+    {
+        host_time_us += 1000000;
+        CHECK(sps30.get_values(&v).ok());
+    }
+
+    CHECK(histogram_count(&sps30, PROFILE_BUILD) == READS);
+    CHECK(histogram_count(&sps30, PROFILE_TX) == READS);
+    CHECK(histogram_count(&sps30, PROFILE_WAIT) == READS);
+    CHECK(histogram_count(&sps30, PROFILE_RX) == READS);
+    CHECK(histogram_count(&sps30, PROFILE_CRC) == 0);
+    CHECK(histogram_count(&sps30, PROFILE_DECODE) == READS);
+}
+
+// A histogram bucket saturates instead of wrapping around.
+static void test_saturation()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    sps30.clear_profile();
+
+    for (uint32_t i = 0; i < 0x10010; i++)
+    {
+        sps30.read_data_ready();
+    }
+
+    const uint16_t *build = sps30.get_profile_histogram(PROFILE_BUILD);
+    uint16_t largest = 0;
+
+    for (uint8_t b = 0; b < PROFILE_BUCKETS; b++)
+    {
+        if (build[b] > largest) largest = build[b];
+    }
+
+    CHECK(largest == 0xFFFF);
+    CHECK(histogram_count(&sps30, PROFILE_BUILD) < 0x10010);
+}
+
+int main()
+{
+    test_uart();
+    test_i2c();
+    test_saturation();
+
+    return test_result("test_profile");
+}
@@ -0,0 +1,185 @@
+/**
+ * SPS30 - Publisher test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Built with PUBLISHER_MAX_CLIENTS 512, see the Makefile, the fan out
+ * runs with 500 clients.
+ *********************************************************************
+*/
+
+#include "sps30_publisher.h"
+#include "test.h"
+
+#define CLIENTS 500
+
+// A client that keeps its last frame and reports the room it is given, -1 leaves availableForWrite to Print.
+class Client : public Print
+{
+public:
+    int room = PUBLISHER_FRAME_LENGTH;
+    uint32_t frames = 0;
+    uint32_t bytes = 0;
+    uint8_t last[PUBLISHER_FRAME_LENGTH];
+
+    size_t write(uint8_t value)
+    {
+        return write(&value, 1);
+    }
+
+    size_t write(const uint8_t *buffer, size_t size)
+    {
+        if (size == PUBLISHER_FRAME_LENGTH)
+        {
+            memcpy(last, buffer, size);
+            frames++;
+        }
+        bytes += size;
+        return size;
+    }
+
+    int availableForWrite()
+    {
+        return room < 0 ? Print::availableForWrite() : room;
+    }
+};
+
+static Measurements measurement(float value)
+{
+    Measurements v;
+    float *values = &v.MassPM1;
+
+    for (int c = 0; c < 10; c++)
+    {
+        values[c] = value + c;
+    }
+    return v;
+}
+
+static uint16_t frame_count(const Client *client)
+{
+    return client->last[2] << 8 | client->last[3];
+}
+
+// Every one of 500 clients gets the same frame of every sensor it subscribed to.
+static void test_fan_out()
+{
+    static SPS30_publisher publisher;
+    static Client clients[CLIENTS];
+
+    CHECK(publisher.add_sensor() == 0);
+    CHECK(publisher.add_sensor() == 1);
+
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        CHECK(publisher.add_client(&clients[i], i % 2 ? 0x01 : 0x03) == i);
+    }
+
+    Measurements v = measurement(1);
+    publisher.publish(0, &v, 1000);
+    publisher.publish(1, &v, 1000);
+    publisher.flush();
+
+    uint32_t frames = 0;
+    boolean same = true;
+
+    for (int i = 0; i < CLIENTS; i++)
+    {
+        frames += clients[i].frames;
+        same &= clients[i].last[1] == (i % 2 ? 0 : 1) && frame_count(&clients[i]) == 1;
+        same &= memcmp(&clients[i].last[4], &clients[0].last[4], PUBLISHER_FRAME_LENGTH - 5) == 0; // All but the CRC
+    }
+
+    CHECK(frames == CLIENTS + CLIENTS / 2);
+    CHECK(publisher.get_sent_count() == CLIENTS + CLIENTS / 2);
+    CHECK(same);
+
+    // A removed client frees its slot for the next one.
+    publisher.remove_client(&clients[7]);
+    CHECK(publisher.add_client(&clients[7]) == 7);
+}
+
+// A client without room skips measurements and gets the latest once it has room again.
+static void test_slow_client()
+{
+    static SPS30_publisher publisher;
+    Client fast, slow;
+
+    publisher.add_sensor();
+    publisher.add_client(&fast);
+    publisher.add_client(&slow);
+
+    slow.room = PUBLISHER_FRAME_LENGTH - 1;
+
+    for (int n = 1; n <= 3; n++)
+    {
+        Measurements v = measurement(n);
+        publisher.publish(0, &v, n * 1000);
+        publisher.flush();
+    }
+
+    CHECK(fast.frames == 3);
+    CHECK(slow.frames == 0);
+    CHECK(publisher.get_skipped_count() == 2);
+
+    slow.room = 100;
+    publisher.flush();
+
+    CHECK(slow.frames == 1);
+    CHECK(frame_count(&slow) == 3);
+    CHECK(memcmp(slow.last, fast.last, PUBLISHER_FRAME_LENGTH) == 0);
+}
+
+// A client that doesn't report its room, like the base Print, still gets every frame.
+static void test_unknown_room()
+{
+    static SPS30_publisher publisher;
+    Client client;
+
+    client.room = -1;
+    CHECK(client.availableForWrite() == 0);
+
+    publisher.add_sensor();
+    publisher.add_client(&client);
+
+    for (int n = 1; n <= 3; n++)
+    {
+        Measurements v = measurement(n);
+        publisher.publish(0, &v, n * 1000);
+        publisher.flush();
+    }
+
+    CHECK(client.frames == 3);
+    CHECK(publisher.get_skipped_count() == 0);
+}
+
+// No more clients than the slots.
+static void test_full()
+{
+    static SPS30_publisher publisher;
+    static Client clients[PUBLISHER_MAX_CLIENTS + 1];
+
+    for (int i = 0; i < PUBLISHER_MAX_CLIENTS; i++)
+    {
+        publisher.add_client(&clients[i]);
+    }
+
+    CHECK(publisher.add_client(&clients[PUBLISHER_MAX_CLIENTS]) == -1);
+}
+
+int main()
+{
+    test_fan_out();
+    test_slow_client();
+    test_unknown_room();
+    test_full();
+
+    return test_result("test_publisher");
+}
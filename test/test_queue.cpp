@@ -0,0 +1,131 @@
+/**
+ * SPS30 - Command queue test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30_queue.h"
+#include "test.h"
+
+// The commands in the order they were called back.
+struct Log
+{
+    uint8_t commands[QUEUE_LENGTH];
+    boolean ok[QUEUE_LENGTH];
+    uint8_t length = 0;
+};
+
+static void record(uint8_t command, SPS30_status status, const Measurements *v, void *ctx)
+{
+    Log *log = (Log *)ctx;
+
+    log->commands[log->length] = command;
+    log->ok[log->length++] = status.ok() && (command != READ_MEASURED_VALUE || v != NULL);
+}
+
+// A start submitted before a stop runs before it, the sensor ends up stopped.
+static void test_fifo()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_queue queue(&sps30);
+    Log log;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+
+    CHECK(queue.submit(START_MEASUREMENT, record, &log));
+    CHECK(queue.submit(STOP_MEASUREMENT, record, &log));
+    CHECK(queue.process() == 2);
+
+    CHECK(log.length == 2);
+    CHECK(log.commands[0] == START_MEASUREMENT && log.ok[0]);
+    CHECK(log.commands[1] == STOP_MEASUREMENT && log.ok[1]);
+    CHECK(!sensor.measuring);
+
+    Serial1.attach(NULL);
+}
+
+// Identical commands other than reads each run, the reads before the stop go before it and the later ones share one read.
+static void test_reads_coalesced()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_queue queue(&sps30);
+    Log log;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    host_time_us += 1100000;
+
+    CHECK(queue.submit(READ_MEASURED_VALUE, record, &log));
+    CHECK(queue.submit(STOP_MEASUREMENT, record, &log));
+    CHECK(queue.submit(READ_MEASURED_VALUE, record, &log));
+    CHECK(queue.submit(START_MEASUREMENT, record, &log));
+    CHECK(queue.submit(START_MEASUREMENT, record, &log));
+    CHECK(queue.submit(READ_MEASURED_VALUE, record, &log));
+
+    CHECK(queue.process() == 5);
+    CHECK(queue.pending() == 0);
+    CHECK(queue.get_coalesced_count() == 1);
+
+    CHECK(log.length == 6);
+    CHECK(log.commands[0] == READ_MEASURED_VALUE && log.ok[0]);
+    CHECK(log.commands[1] == STOP_MEASUREMENT);
+    CHECK(log.commands[2] == START_MEASUREMENT);
+    CHECK(log.commands[3] == START_MEASUREMENT);
+    CHECK(log.commands[4] == READ_MEASURED_VALUE && log.ok[4]);
+    CHECK(log.commands[5] == READ_MEASURED_VALUE && log.ok[5]);
+    CHECK(sensor.measuring);
+
+    Serial1.attach(NULL);
+}
+
+// A read submitted before a stop or sleep reads the running sensor, it doesn't start it again afterwards.
+static void test_read_before(uint8_t command)
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_queue queue(&sps30);
+    Log log;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    host_time_us += 1100000;
+    sensor.commands.clear();
+
+    CHECK(queue.submit(READ_MEASURED_VALUE, record, &log));
+    CHECK(queue.submit(command, record, &log));
+    CHECK(queue.process() == 2);
+
+    CHECK(log.length == 2);
+    CHECK(log.commands[0] == READ_MEASURED_VALUE && log.ok[0]);
+    CHECK(log.commands[1] == command && log.ok[1]);
+    CHECK(sensor.value_reads == 1);
+    CHECK(sensor.commands.size() >= 2 && sensor.commands[0] == READ_MEASURED_VALUE);
+    CHECK(!sensor.measuring);
+    CHECK(!sps30.is_started());
+    CHECK(sensor.sleeping == (command == SLEEP));
+
+    Serial1.attach(NULL);
+}
+
+int main()
+{
+    test_fifo();
+    test_reads_coalesced();
+    test_read_before(STOP_MEASUREMENT);
+    test_read_before(SLEEP);
+
+    return test_result("test_queue");
+}
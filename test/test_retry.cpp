@@ -0,0 +1,127 @@
+/**
+ * SPS30 - Retry and backoff test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+// NAKs are retried, the wait before every next retry doubles.
+static void test_nack_backoff()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    RetryPolicy policy = {4, 10, false};
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(sps30.start().ok());
+    sps30.set_retry_policy(policy);
+    sps30.clear_retry_count();
+    CHECK(sps30.read_data_ready().ok()); // Learn the latency first.
+
+    sensor.nack = 3;
+    uint64_t start = host_time_us;
+
+    CHECK(sps30.read_data_ready().ok());
+    uint32_t ms = (host_time_us - start) / 1000;
+
+    CHECK(sps30.get_retry_count() == 3);
+    CHECK(sps30.get_failure_count() == 0);
+    CHECK(ms >= 10 + 20 + 40);
+    CHECK(ms < 10 + 20 + 40 + 4 * RX_DELAY_MS);
+}
+
+// When every attempt fails the last error is returned and counted once.
+static void test_nack_exhausted()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    RetryPolicy policy = {3, 5, true};
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    sps30.set_retry_policy(policy);
+    sps30.clear_retry_count();
+
+    sensor.nack = 3;
+    CHECK(sps30.start().error == SPS30_ERROR_NACK);
+    CHECK(sps30.get_retry_count() == 2);
+    CHECK(sps30.get_failure_count() == 1);
+    CHECK(!sensor.measuring);
+
+    CHECK(sps30.start().ok()); // The NAKs are used up.
+    CHECK(sensor.measuring);
+}
+
+// Lost and broken UART answers are retried, the sensor gets the command again.
+static void test_time_out_and_crc()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    sps30.clear_retry_count();
+
+    size_t sent = sensor.commands.size();
+    sensor.drop = 1;
+    CHECK(sps30.get_values(&v).ok());
+    CHECK(sps30.get_retry_count() == 1);
+    CHECK(sensor.commands.size() == sent + 2);
+
+    sensor.corrupt = 1;
+    CHECK(sps30.get_values(&v).ok());
+    CHECK(sps30.get_retry_count() == 2);
+
+    sensor.drop = RETRY_ATTEMPTS;
+    CHECK(sps30.get_values(&v).error == SPS30_ERROR_TIMEOUT);
+    CHECK(sps30.get_retry_count() == 2 + RETRY_ATTEMPTS - 1);
+    CHECK(sps30.get_failure_count() == 1);
+
+    Serial1.attach(NULL);
+}
+
+// A state error is the answer of the sensor, repeating the command doesn't change it.
+static void test_state_error_not_retried()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Measurements v;
+
+    sensor.attach(&Serial1);
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(sps30.start().ok());
+    sps30.clear_retry_count();
+
+    sensor.measuring = false;
+    size_t sent = sensor.commands.size();
+
+    CHECK(sps30.get_values(&v).error == SPS30_ERROR_STATE_NOT_ALLOWED);
+    CHECK(sps30.get_retry_count() == 0);
+    CHECK(sps30.get_failure_count() == 1);
+    CHECK(sensor.commands.size() == sent + 1);
+
+    Serial1.attach(NULL);
+}
+
+int main()
+{
+    test_nack_backoff();
+    test_nack_exhausted();
+    test_time_out_and_crc();
+    test_state_error_not_retried();
+
+    return test_result("test_retry");
+}
@@ -0,0 +1,67 @@
+/**
+ * SPS30 - Rollup test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sps30_rollup.h"
+#include "test.h"
+
+static Measurements measurement(float value)
+{
+    Measurements v;
+    float *values = &v.MassPM1;
+
+    for (int c = 0; c < ROLLUP_CHANNELS; c++)
+    {
+        values[c] = value;
+    }
+    return v;
+}
+
+// A sample may not go back in time, the same second is allowed.
+static void test_order()
+{
+    static SPS30_rollup rollup;
+    Measurements v = measurement(1);
+
+    CHECK(rollup.add(&v, 1000));
+    CHECK(rollup.add(&v, 1000));
+    CHECK(rollup.add(&v, 1001));
+    CHECK(!rollup.add(&v, 999));
+}
+
+// The time may wrap around at 2^32, the samples after it are kept.
+static void test_wrap()
+{
+    static SPS30_rollup rollup;
+    RollupBucket buckets[4];
+
+    for (uint32_t time = 0xFFFFFFFE, i = 0; i < 4; time++, i++)
+    {
+        Measurements v = measurement(i);
+        CHECK(rollup.add(&v, time));
+    }
+
+    Measurements v = measurement(9);
+    CHECK(!rollup.add(&v, 0xFFFFFFFF)); // Before the newest sample at 1
+
+    CHECK(rollup.query(0, 1, 1, buckets, 4) == 2);
+    CHECK(buckets[0].start == 0 && buckets[0].mean[0] == 2);
+    CHECK(buckets[1].start == 1 && buckets[1].mean[0] == 3);
+}
+
+int main()
+{
+    test_order();
+    test_wrap();
+
+    return test_result("test_rollup");
+}
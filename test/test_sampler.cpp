@@ -0,0 +1,145 @@
+/**
+ * SPS30 - Sampler test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * The simulated sensor samples every SIM_SAMPLE_MS from the moment it
+ * was started. The loop polls the sampler every ms of the host clock.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30_sampler.h"
+#include "test.h"
+
+struct Run
+{
+    uint32_t reads = 0;
+    uint32_t off_phase = 0; // Reads whose time is more than two polls away from a sample of the sensor
+};
+
+// run polls the sampler for a while, the sensor samples at start + n * SIM_SAMPLE_MS.
+static Run run(SPS30_sampler *sampler, uint32_t duration, uint32_t start)
+{
+    Run result;
+    uint32_t end = millis() + duration;
+
+    while ((int32_t)(millis() - end) < 0)
+    {
+        Measurements v;
+        uint32_t time;
+        SPS30_value<boolean> fresh = sampler->poll(&v, &time);
+
+        if (fresh.ok() && fresh.value)
+        {
+            uint32_t offset = (time - start) % SIM_SAMPLE_MS;
+
+            result.reads++;
+            result.off_phase += offset > 2 * SAMPLER_POLL_MS && offset < SIM_SAMPLE_MS - 2 * SAMPLER_POLL_MS;
+        }
+
+        delay(1);
+    }
+
+    return result;
+}
+
+// Over I2C the sampler starts the sensor, finds its phase and reads every sample once, just after it.
+static void test_phase_lock()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_sampler sampler(&sps30);
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+    CHECK(!sps30.is_started());
+
+    uint32_t start = millis();
+    run(&sampler, 5000, start);
+
+    CHECK(sensor.measuring);
+    CHECK(sampler.locked());
+
+    uint32_t wasted = sampler.get_wasted_count();
+    uint32_t value_reads = sensor.value_reads;
+    Run locked = run(&sampler, 30000, start);
+
+    CHECK(locked.reads >= 29 && locked.reads <= 31);
+    CHECK(locked.off_phase == 0);
+    CHECK(sensor.value_reads - value_reads == locked.reads);
+    CHECK(sampler.get_wasted_count() - wasted < locked.reads); // Less than one early check per sample
+    CHECK(sampler.get_drift_ppm() > -2000 && sampler.get_drift_ppm() < 2000);
+
+    Wire.attach(NULL);
+}
+
+// Over UART samples with the same values are read too, once per interval and not more.
+static void test_uart()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_sampler sampler(&sps30);
+
+    sensor.attach(&Serial1);
+    memset(sensor.values, 0, sizeof(sensor.values)); // All 0.0, every sample is the same
+    CHECK(sps30.begin(&Serial1).ok());
+
+    Run uart = run(&sampler, 10000, millis());
+
+    CHECK(sensor.measuring);
+    CHECK(uart.reads >= 9 && uart.reads <= 10);
+    CHECK(sensor.value_reads == uart.reads);
+    CHECK(!sampler.locked());
+
+    Serial1.attach(NULL);
+}
+
+// A sensor that stops sampling loses the lock, after a restart the sampler locks on the new phase.
+static void test_relock()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    SPS30_sampler sampler(&sps30);
+
+    sensor.attach(&Wire);
+    CHECK(sps30.begin(&Wire).ok());
+
+    run(&sampler, 5000, millis());
+    CHECK(sampler.locked());
+
+    sensor.measuring = false; // Stopped behind the back of the driver, no data ready any more
+    Run silent = run(&sampler, SAMPLER_MAX_MISSES * SAMPLER_POLL_MS + 1000, millis());
+
+    CHECK(silent.reads == 0);
+    CHECK(!sampler.locked());
+
+    delay(SIM_SAMPLE_MS / 3); // The new phase is a third of a sample away from the old one
+    uint32_t start = millis();
+    CHECK(sps30.start().ok());
+
+    run(&sampler, 5000, start);
+    CHECK(sampler.locked());
+
+    Run relocked = run(&sampler, 10000, start);
+    CHECK(relocked.reads >= 9 && relocked.reads <= 11);
+    CHECK(relocked.off_phase == 0);
+
+    Wire.attach(NULL);
+}
+
+int main()
+{
+    test_phase_lock();
+    test_uart();
+    test_relock();
+
+    return test_result("test_sampler");
+}
@@ -0,0 +1,187 @@
+/**
+ * SPS30 - Serializer test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Compares the JSON and CBOR output byte for byte with records that
+ * were written out by hand.
+ *********************************************************************
+*/
+
+#include "sps30_serializer.h"
+#include "test.h"
+
+static Measurements measurement()
+{
+    Measurements v;
+
+    v.MassPM1 = 1.5;
+    v.MassPM2 = 2.25;
+    v.MassPM4 = -0.5;
+    v.MassPM10 = 100;
+    v.NumPM0 = 0;
+    v.NumPM1 = 0.1;
+    v.NumPM2 = NAN;
+    v.NumPM4 = 1e10;
+    v.NumPM10 = 65504;
+    v.PartSize = 0.3;
+
+    return v;
+}
+
+static boolean same(const uint8_t *buffer, size_t length, const uint8_t *expected, size_t expected_length)
+{
+    if (length != expected_length || memcmp(buffer, expected, length) != 0)
+    {
+        printf("got      ");
+        for (size_t i = 0; i < length; i++)
+        {
+            printf("%02X ", buffer[i]);
+        }
+        printf("\nexpected ");
+        for (size_t i = 0; i < expected_length; i++)
+        {
+            printf("%02X ", expected[i]);
+        }
+        printf("\n");
+        return false;
+    }
+
+    return true;
+}
+
+static void test_json()
+{
+    uint8_t buffer[512];
+    SPS30_serializer json(buffer, sizeof(buffer));
+    Measurements v = measurement();
+    DeviceHealth health;
+    const char *expected =
+        "{\"pm1\":1.50,\"pm2\":2.25,\"pm4\":-0.50,\"pm10\":100.00,\"n0\":0.00,\"n1\":0.10,"
+        "\"n2\":null,\"n4\":10000000.00e3,\"n10\":65504.00,\"size\":0.30,"
+        "\"sn\":\"AB\\\"C\\\\D\\u0001\",\"t\":1234,\"st\":2097168}";
+
+    memset(&health, 0, sizeof(health));
+    health.status_register = 0x00200010;
+
+    json.set_serial("AB\"C\\D\x01");
+    json.add(&v, 1234, &health);
+
+    CHECK(!json.overflow());
+    CHECK(same(buffer, json.length(), (const uint8_t *)expected, strlen(expected)));
+}
+
+// A batch is an array, the decimals can be changed.
+static void test_json_batch()
+{
+    uint8_t buffer[512];
+    SPS30_serializer json(buffer, sizeof(buffer));
+    Measurements v;
+    const char *expected =
+        "[{\"pm1\":1.0,\"pm2\":0.0,\"pm4\":0.0,\"pm10\":0.0,\"n0\":0.0,\"n1\":0.0,\"n2\":0.0,\"n4\":0.0,\"n10\":0.0,\"size\":0.0},"
+        "{\"pm1\":2.0,\"pm2\":0.0,\"pm4\":0.0,\"pm10\":0.0,\"n0\":0.0,\"n1\":0.0,\"n2\":0.0,\"n4\":0.0,\"n10\":0.0,\"size\":0.0}]";
+
+    memset(&v, 0, sizeof(v));
+    json.set_decimals(1);
+    json.begin();
+    v.MassPM1 = 1;
+    json.add(&v);
+    v.MassPM1 = 2;
+    json.add(&v);
+
+    CHECK(json.end() == strlen(expected));
+    CHECK(same(buffer, json.length(), (const uint8_t *)expected, strlen(expected)));
+}
+
+// Floats are single precision, big endian, keys and the serial number are text strings.
+static void test_cbor()
+{
+    uint8_t buffer[512];
+    SPS30_serializer cbor(buffer, sizeof(buffer), FORMAT_CBOR);
+    Measurements v = measurement();
+    DeviceHealth health;
+    const uint8_t expected[] = {
+        0xAD,                                          // Map of 13
+        0x63, 'p', 'm', '1', 0xFA, 0x3F, 0xC0, 0x00, 0x00,
+        0x63, 'p', 'm', '2', 0xFA, 0x40, 0x10, 0x00, 0x00,
+        0x63, 'p', 'm', '4', 0xFA, 0xBF, 0x00, 0x00, 0x00,
+        0x64, 'p', 'm', '1', '0', 0xFA, 0x42, 0xC8, 0x00, 0x00,
+        0x62, 'n', '0', 0xFA, 0x00, 0x00, 0x00, 0x00,
+        0x62, 'n', '1', 0xFA, 0x3D, 0xCC, 0xCC, 0xCD,
+        0x62, 'n', '2', 0xFA, 0x7F, 0xC0, 0x00, 0x00, // NaN
+        0x62, 'n', '4', 0xFA, 0x50, 0x15, 0x02, 0xF9,
+        0x63, 'n', '1', '0', 0xFA, 0x47, 0x7F, 0xE0, 0x00,
+        0x64, 's', 'i', 'z', 'e', 0xFA, 0x3E, 0x99, 0x99, 0x9A,
+        0x62, 's', 'n', 0x66, 'A', 'B', '"', 'C', '\\', 'D',
+        0x61, 't', 0x19, 0x04, 0xD2,                   // 1234
+        0x62, 's', 't', 0x1A, 0x00, 0x20, 0x00, 0x10}; // 2097168
+
+    memset(&health, 0, sizeof(health));
+    health.status_register = 0x00200010;
+
+    cbor.set_serial("AB\"C\\D");
+    cbor.add(&v, 1234, &health);
+
+    CHECK(!cbor.overflow());
+    CHECK(same(buffer, cbor.length(), expected, sizeof(expected)));
+}
+
+// A batch is an array of indefinite length, the time takes the shortest encoding.
+static void test_cbor_batch()
+{
+    uint8_t buffer[512];
+    SPS30_serializer cbor(buffer, sizeof(buffer), FORMAT_CBOR);
+    Measurements v;
+
+    memset(&v, 0, sizeof(v));
+    cbor.begin();
+    cbor.add(&v, 23);
+    cbor.add(&v, 24);
+    cbor.add(&v, 70000);
+    size_t length = cbor.end();
+
+    size_t record = 1 + 10 * 5 + (3 * 4 + 5 + 4 * 3 + 4 + 5) + 2; // Map, floats, keys and "t", without the time
+    CHECK(length == 1 + (record + 1) + (record + 2) + (record + 5) + 1);
+    CHECK(buffer[0] == 0x9F);
+    CHECK(buffer[1] == 0xAB); // Map of 11
+    CHECK(buffer[1 + record] == 23);
+    CHECK(buffer[2 + record] == 0xAB);
+    CHECK(buffer[2 + 2 * record] == 0x18 && buffer[3 + 2 * record] == 24);
+    CHECK(buffer[4 + 3 * record] == 0x1A); // 70000 takes 4 bytes
+    CHECK(buffer[length - 1] == 0xFF);
+}
+
+// What doesn't fit the buffer is dropped and flagged, nothing is added after that.
+static void test_overflow()
+{
+    uint8_t buffer[40];
+    SPS30_serializer json(buffer, sizeof(buffer));
+    Measurements v;
+
+    memset(&v, 0, sizeof(v));
+    json.add(&v);
+
+    CHECK(json.overflow());
+    CHECK(json.length() <= sizeof(buffer));
+
+    json.clear();
+    CHECK(!json.overflow() && json.length() == 0);
+}
+
+int main()
+{
+    test_json();
+    test_json_batch();
+    test_cbor();
+    test_cbor_batch();
+    test_overflow();
+
+    return test_result("test_serializer");
+}
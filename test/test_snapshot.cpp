@@ -0,0 +1,147 @@
+/**
+ * SPS30 - Snapshot test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * One writer publishes as fast as it can while several readers copy
+ * the snapshot. Every published field is derived from the count, so a
+ * reader that got parts of two snapshots notices.
+ *********************************************************************
+*/
+
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <thread>
+
+#include "sps30_snapshot.h"
+#include "test.h"
+
+#define PUBLISHES 200000
+#define READERS 4
+
+static SPS30_snapshot snapshot;
+static std::atomic<bool> writing(true);
+
+struct Reader
+{
+    uint32_t reads = 0;     // Consistent copies
+    uint32_t overtaken = 0; // Reads that gave up, the writer overtook every try
+    uint32_t torn = 0;      // Copies with fields of different snapshots
+    uint32_t backwards = 0; // Copies older than the previous one
+};
+
+static void publish(uint32_t n)
+{
+    Measurements v;
+    DeviceHealth health;
+    float *values = &v.MassPM1;
+
+    for (int c = 0; c < 10; c++)
+    {
+        values[c] = n + c;
+    }
+    health.status_register = n * 3;
+
+    snapshot.publish(&v, n * 7, &health);
+}
+
+static void read_loop(Reader *reader)
+{
+    uint32_t last = 0;
+
+    while (writing.load())
+    {
+        SnapshotData data;
+
+        if (!snapshot.read(&data))
+        {
+            reader->overtaken++;
+            continue;
+        }
+
+        uint32_t n = data.count; // The first publish is n = 1
+        const float *values = &data.values.MassPM1;
+        boolean torn = data.time != n * 7 || data.status_register != n * 3;
+
+        for (int c = 0; c < 10; c++)
+        {
+            torn |= values[c] != (float)(n + c);
+        }
+
+        reader->torn += torn;
+        reader->backwards += n < last;
+        reader->reads++;
+        last = n;
+    }
+}
+
+// The constructor empties a snapshot, whatever the memory held before.
+static void test_empty()
+{
+    alignas(SPS30_snapshot) uint8_t memory[sizeof(SPS30_snapshot)];
+    SnapshotData data;
+
+    memset(memory, 0xA5, sizeof(memory));
+    SPS30_snapshot *fresh = new (memory) SPS30_snapshot();
+
+    CHECK(!fresh->read(&data));
+    CHECK(data.count == 0);
+    CHECK(data.status_register == 0);
+}
+
+static void test_concurrent_readers()
+{
+    Reader readers[READERS];
+    std::thread threads[READERS];
+
+    for (int i = 0; i < READERS; i++)
+    {
+        threads[i] = std::thread(read_loop, &readers[i]);
+    }
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (uint32_t n = 1; n <= PUBLISHES; n++)
+    {
+        publish(n);
+    }
+    writing.store(false);
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    uint32_t reads = 0;
+
+    for (int i = 0; i < READERS; i++)
+    {
+        threads[i].join();
+        CHECK(readers[i].torn == 0);
+        CHECK(readers[i].backwards == 0);
+        reads += readers[i].reads;
+    }
+
+    CHECK(reads > 0);
+    printf("%d publishes and %u reads by %d readers in %.3f s, %.1f M reads/s\n",
+           PUBLISHES, reads, READERS, seconds, reads / seconds / 1e6);
+
+    SnapshotData data;
+    CHECK(snapshot.read(&data));
+    CHECK(data.count == PUBLISHES);
+
+    snapshot.clear();
+    CHECK(!snapshot.read(&data));
+}
+
+int main()
+{
+    test_empty();
+    test_concurrent_readers();
+
+    return test_result("test_snapshot");
+}
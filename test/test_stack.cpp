@@ -0,0 +1,255 @@
+/**
+ * SPS30 - Stack use test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************
+ * Measures the peak stack use of every public command: the command
+ * runs on a thread with a painted stack, the deepest byte that was
+ * written is its peak. The simulated sensor has deep frames of its
+ * own, so every command is first run against it while its answers
+ * are taped, then measured on a second instance that gets the taped
+ * answers. The numbers include the serial port and Wire stubs, about
+ * what a write only command like stop() uses. Built without the
+ * sanitizers, they change the frames.
+ *********************************************************************
+*/
+
+#include <pthread.h>
+
+#include <deque>
+#include <vector>
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+#define STACK_SIZE 0x40000 // Bytes of the thread stack
+#define STACK_PAINT 0xA5
+#define STACK_BOUND 1024 // Most a command may use on the host with the stubs, x86-64 frames are larger than on AVR
+
+// Tape answers like the simulated sensor while recording, and with the recorded answers while playing.
+class Tape : public HostSerialDevice, public HostWireDevice
+{
+public:
+    Tape(SimSPS30 *sensor) : _sensor(sensor) {}
+
+    boolean recording = true;
+
+    void received(HardwareSerial *port, uint8_t value)
+    {
+        if (recording)
+        {
+            _sensor->received(&_scratch, value);
+        }
+
+        if (value != 0x7E || (_in_frame = !_in_frame))
+        {
+            return;
+        }
+
+        if (recording)
+        {
+            host_time_us += _sensor->latency_us + 1000;
+
+            std::vector<uint8_t> taped;
+            while (_scratch.available())
+            {
+                taped.push_back(_scratch.read());
+            }
+            _answers.push_back(taped);
+        }
+
+        const std::vector<uint8_t> &answer = recording ? _answers.back() : _answers.front();
+        port->respond(answer.data(), answer.size(), SIM_LATENCY_US);
+        if (!recording)
+        {
+            _answers.pop_front();
+        }
+    }
+
+    uint8_t transmission(uint8_t address, const uint8_t *data, size_t length)
+    {
+        if (recording)
+        {
+            _acks.push_back(_sensor->transmission(address, data, length));
+        }
+
+        uint8_t ack = recording ? _acks.back() : _acks.front();
+        if (!recording)
+        {
+            _acks.pop_front();
+        }
+        return ack;
+    }
+
+    size_t request(uint8_t address, uint8_t *data, size_t length)
+    {
+        if (recording)
+        {
+            std::vector<uint8_t> taped(length);
+            taped.resize(_sensor->request(address, taped.data(), length));
+            _answers.push_back(taped);
+        }
+
+        const std::vector<uint8_t> &answer = recording ? _answers.back() : _answers.front();
+        size_t count = answer.size();
+        memcpy(data, answer.data(), count);
+        if (!recording)
+        {
+            _answers.pop_front();
+        }
+        return count;
+    }
+
+    // rewind plays what was recorded since the last rewind.
+    void rewind()
+    {
+        recording = false;
+    }
+
+    boolean played() { return _answers.empty() && _acks.empty(); }
+
+    void record()
+    {
+        _answers.clear();
+        _acks.clear();
+        recording = true;
+    }
+
+private:
+    SimSPS30 *_sensor;
+    HardwareSerial _scratch;
+    boolean _in_frame = false;
+    std::deque<std::vector<uint8_t> > _answers;
+    std::deque<uint8_t> _acks;
+};
+
+struct Command
+{
+    const char *name;
+    boolean (*run)(SPS30 *sps30, boolean i2c);
+};
+
+static const Command commands[] = {
+    {"begin", [](SPS30 *s, boolean i2c) { return i2c ? s->begin(&Wire).ok() : s->begin(&Serial1).ok(); }},
+    {"probe", [](SPS30 *s, boolean) { return s->probe().ok(); }},
+    {"read_version", [](SPS30 *s, boolean) { Version v; return s->read_version(&v).ok(); }},
+    {"get_serial_number", [](SPS30 *s, boolean) { char t[32]; return s->get_serial_number(t, sizeof(t)).ok(); }},
+    {"get_product_type", [](SPS30 *s, boolean) { char t[16]; return s->get_product_type(t, sizeof(t)).ok(); }},
+    {"get_auto_clean_interval", [](SPS30 *s, boolean) { return s->get_auto_clean_interval().ok(); }},
+    {"set_auto_clean_interval", [](SPS30 *s, boolean) { return s->set_auto_clean_interval(86400).ok(); }},
+    {"read_device_health", [](SPS30 *s, boolean) { DeviceHealth h; return s->read_device_health(&h).ok(); }},
+    {"start", [](SPS30 *s, boolean) { return s->start().ok(); }},
+    {"read_data_ready", [](SPS30 *s, boolean i2c) { return !i2c || s->read_data_ready().ok(); }},
+    {"get_values", [](SPS30 *s, boolean) { Measurements v; return s->get_values(&v).ok(); }},
+    {"get_mass_PM2", [](SPS30 *s, boolean) { return s->get_mass_PM2().ok(); }},
+    {"clean", [](SPS30 *s, boolean) { return s->clean().ok(); }},
+    {"stop", [](SPS30 *s, boolean) { return s->stop().ok(); }},
+    {"sleep", [](SPS30 *s, boolean) { return s->sleep().ok(); }},
+    {"wake_up", [](SPS30 *s, boolean) { return s->wake_up().ok(); }},
+    {"reset", [](SPS30 *s, boolean) { return s->reset().ok(); }},
+};
+
+struct Run
+{
+    const Command *command;
+    SPS30 *sps30;
+    boolean i2c;
+    boolean ok;
+};
+
+static void *run_command(void *argument)
+{
+    Run *run = (Run *)argument;
+
+    if (run->command != NULL)
+    {
+        run->ok = run->command->run(run->sps30, run->i2c);
+    }
+    return NULL;
+}
+
+// peak_stack runs a command on a painted stack and returns the bytes it wrote, the thread itself included.
+static size_t peak_stack(Run *run)
+{
+    static uint8_t *stack = NULL;
+    pthread_attr_t attributes;
+    pthread_t thread;
+
+    if (stack == NULL && posix_memalign((void **)&stack, 4096, STACK_SIZE) != 0)
+    {
+        return STACK_SIZE;
+    }
+
+    memset(stack, STACK_PAINT, STACK_SIZE);
+    pthread_attr_init(&attributes);
+    pthread_attr_setstack(&attributes, stack, STACK_SIZE);
+    pthread_create(&thread, &attributes, run_command, run);
+    pthread_join(thread, NULL);
+    pthread_attr_destroy(&attributes);
+
+    size_t untouched = 0;
+    while (untouched < STACK_SIZE && stack[untouched] == STACK_PAINT)
+    {
+        untouched++;
+    }
+
+    return STACK_SIZE - untouched;
+}
+
+static void test_commands(boolean i2c)
+{
+    SimSPS30 sensor;
+    Tape tape(&sensor);
+    SPS30 recorded;
+    SPS30 measured;
+    Run thread = {NULL, NULL, i2c, false};
+    size_t base = peak_stack(&thread); // The thread without a command
+
+    if (i2c)
+    {
+        Wire.attach(&tape);
+    }
+    else
+    {
+        Serial1.attach(&tape);
+    }
+
+    printf("%s, bytes of stack per command:\n", i2c ? "I2C" : "UART");
+
+    for (size_t c = 0; c < sizeof(commands) / sizeof(commands[0]); c++)
+    {
+        host_time_us += 1100000; // A new measurement for every command
+
+        tape.record();
+        boolean ok = commands[c].run(&recorded, i2c);
+
+        Run run = {&commands[c], &measured, i2c, false};
+        tape.rewind();
+        size_t peak = peak_stack(&run) - base;
+
+        printf("  %-24s %4zu\n", commands[c].name, peak);
+        CHECK(ok);
+        CHECK(run.ok == ok); // The taped answers took the same path
+        CHECK(tape.played());
+        CHECK(peak < STACK_BOUND);
+    }
+
+    Wire.attach(NULL);
+    Serial1.attach(NULL);
+}
+
+int main()
+{
+    test_commands(false);
+    test_commands(true);
+
+    return test_result("test_stack");
+}
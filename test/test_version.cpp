@@ -0,0 +1,109 @@
+/**
+ * SPS30 - Firmware capability test
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *********************************************************************
+*/
+
+#include "sim_sps30.h"
+#include "sps30.h"
+#include "test.h"
+
+// A sensor that sleeps while the board restarts doesn't answer begin(), wake_up() still wakes it.
+static void test_wake_after_restart_i2c()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Wire);
+    sensor.sleeping = true;
+
+    CHECK(!sps30.begin(&Wire).ok());
+    CHECK(sps30.wake_up().ok());
+    CHECK(!sensor.sleeping);
+
+    CHECK(sps30.probe().ok());
+    CHECK(sps30.supports(CAPABILITY_SLEEP));
+    CHECK(sps30.sleep().ok());
+    CHECK(sensor.sleeping);
+}
+
+static void test_wake_after_restart_uart()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Serial1);
+    sensor.sleeping = true;
+
+    CHECK(!sps30.begin(&Serial1).ok());
+    CHECK(sps30.wake_up().ok());
+    CHECK(!sensor.sleeping);
+    CHECK(sps30.supports(CAPABILITY_STATUS_REGISTER));
+
+    Serial1.attach(NULL);
+}
+
+// Firmware before 2.0 rejects the wake up and sleep commands, that is detected and kept.
+static void test_old_firmware()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+
+    sensor.attach(&Serial1);
+    sensor.firmware_major = 1;
+    sensor.firmware_minor = 0;
+
+    CHECK(sps30.begin(&Serial1).ok());
+    CHECK(!sps30.supports(CAPABILITY_SLEEP));
+
+    size_t sent = sensor.commands.size();
+    CHECK(sps30.wake_up().error == SPS30_ERROR_UNSUPPORTED);
+    CHECK(sensor.commands.size() == sent); // Known to be unsupported, nothing is sent.
+
+    CHECK(sps30.start().ok());
+    CHECK(sps30.sleep().error == SPS30_ERROR_UNSUPPORTED);
+    CHECK(!sensor.measuring); // Stopped instead
+
+    Serial1.attach(NULL);
+}
+
+// A version read that times out isn't taken for old firmware, the next use reads it again.
+static void test_time_out_not_latched()
+{
+    SimSPS30 sensor;
+    SPS30 sps30;
+    Version version;
+    RetryPolicy once = {1, 0, false};
+
+    sensor.attach(&Serial1);
+    sensor.firmware_minor = 0;
+    sps30.set_retry_policy(once);
+    sensor.drop = 2;
+    CHECK(sps30.begin(&Serial1).error == SPS30_ERROR_TIMEOUT);
+    CHECK(sps30.read_version(&version).error == SPS30_ERROR_TIMEOUT);
+
+    sensor.drop = 1;
+    CHECK(sps30.supports(CAPABILITY_STATUS_REGISTER)); // Assumed while the version can't be read
+
+    CHECK(sps30.supports(CAPABILITY_SLEEP)); // Read again, 2.0 can sleep
+    CHECK(!sps30.supports(CAPABILITY_STATUS_REGISTER));
+
+    Serial1.attach(NULL);
+}
+
+int main()
+{
+    test_wake_after_restart_i2c();
+    test_wake_after_restart_uart();
+    test_old_firmware();
+    test_time_out_not_latched();
+
+    return test_result("test_version");
+}